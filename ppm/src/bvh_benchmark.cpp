@@ -0,0 +1,764 @@
+#include "ragine.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <tuple>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// BVH 性能测试：在 scene_test 的 random_world 球阵上比较构建时间、期望遍历代价与光线吞吐量
+// 场景使用固定种子生成，保证多次运行之间可以直接比较
+
+static std::mt19937 scene_rng(42);
+
+static double scene_random() {
+    return std::uniform_real_distribution<double>(0.0, 1.0)(scene_rng);
+}
+
+/// @brief 生成与 random_world() 相同布局的小球阵列 (不含地面)
+/// @param grid 网格半径，11 对应 scene_test 的 22x22 阵列
+HittableList random_balls(int grid = 11) {
+    HittableList balls;
+    scene_rng.seed(42);
+    auto material = std::make_shared<Lambertian>(Colors::Gray50);
+
+    for (int a = -grid; a < grid; a++) {
+        for (int b = -grid; b < grid; b++) {
+            vec3 center{a + 0.9 * scene_random(), 0.2, b + 0.9 * scene_random()};
+            if ((center - vec3{4, 0.2, 0}).length() > 0.9) {
+                balls.add(std::make_shared<Sphere>(center, 0.2, material));
+            }
+        }
+    }
+
+    balls.add(std::make_shared<Sphere>(vec3{0, 1, 0}, 1.0, material));
+    balls.add(std::make_shared<Sphere>(vec3{4, 1, 2}, 1.0, material));
+    balls.add(std::make_shared<Sphere>(vec3{4, 1, 0}, 1.0, material));
+    return balls;
+}
+
+/// @brief 写出一个圆环的 OBJ 文件 (v / vt / vn 与四边形面)，三角形数为 segments * segments
+/// @return 写入成功返回 true
+bool write_torus_obj(const std::string& path, int segments) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) return false;
+
+    const int rings = segments, sides = std::max(3, segments / 2);
+    const double major = 2.0, minor = 0.6;
+    std::fprintf(file, "# torus %d x %d\no torus\n", rings, sides);
+    for (int i = 0; i < rings; i++) {
+        for (int j = 0; j < sides; j++) {
+            double u = 2.0 * M_PI * i / rings, v = 2.0 * M_PI * j / sides;
+            std::fprintf(file, "v %.7f %.7f %.7f\n", (major + minor * std::cos(v)) * std::cos(u), 1.0 + minor * std::sin(v),
+                (major + minor * std::cos(v)) * std::sin(u));
+            std::fprintf(file, "vt %.6f %.6f\n", double(i) / rings, double(j) / sides);
+            std::fprintf(file, "vn %.6f %.6f %.6f\n", std::cos(v) * std::cos(u), std::sin(v), std::cos(v) * std::sin(u));
+        }
+    }
+    for (int i = 0; i < rings; i++) {
+        for (int j = 0; j < sides; j++) {
+            int a = i * sides + j + 1, b = (i + 1) % rings * sides + j + 1;
+            int c = (i + 1) % rings * sides + (j + 1) % sides + 1, d = i * sides + (j + 1) % sides + 1;
+            std::fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, d, d, d, c, c, c, b, b, b);
+        }
+    }
+    return std::fclose(file) == 0;
+}
+
+/// @brief 以 scene_test 的相机发射主光线，返回每秒光线数 (百万)
+/// @param shutter 快门关闭时刻，大于 0 时每条光线的时刻在 [0, shutter] 内随机
+double trace_primary(const Hittable& world, int width, int height, int repeat, size_t& hits, double shutter = 0.0) {
+    Camera camera({13, 2, 3}, {0, 0, 0}, {0, 1, 0}, 20.0, double(width) / height);
+    camera.set_shutter(0.0, shutter);
+    hits = 0;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < repeat; r++) {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                ray primary = camera.get_ray(double(x) / (width - 1), double(y) / (height - 1));
+                hit record;
+                if (world.is_hit(primary, record, MINIMUM, INFINITY)) hits++;
+            }
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start_time;
+
+    return double(width) * height * repeat / elapsed.count() / 1e6;
+}
+
+/// @brief 对主光线的交点向点光源发射阴影光线，返回每秒阴影光线数 (百万)
+/// @param any_hit true 使用 is_occluded，false 使用完整的 is_hit
+double trace_shadow(const Hittable& world, int width, int height, bool any_hit, size_t& blocked) {
+    Camera camera({13, 2, 3}, {0, 0, 0}, {0, 1, 0}, 20.0, double(width) / height);
+    const vec3 light_pos{10.0, 10.0, -5.0};
+    std::vector<vec3> origins;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            ray primary = camera.get_ray(double(x) / (width - 1), double(y) / (height - 1));
+            hit record;
+            if (world.is_hit(primary, record, MINIMUM, INFINITY)) origins.push_back(record.position);
+        }
+    }
+
+    blocked = 0;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (const vec3& origin : origins) {
+        ray shadow_ray{origin, (light_pos - origin).normalize()};
+        double light_distance = (light_pos - origin).length();
+        if (any_hit) {
+            if (world.is_occluded(shadow_ray, MINIMUM, light_distance)) blocked++;
+        } else {
+            hit record;
+            if (world.is_hit(shadow_ray, record, MINIMUM, light_distance)) blocked++;
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start_time;
+
+    return origins.size() / elapsed.count() / 1e6;
+}
+
+/// @brief 在场景范围内随机发射方向随机的光线，模拟漫反射二次光线这类不相干的访问模式，返回每秒光线数 (百万)
+double trace_random(const Hittable& world, double extent, size_t count, size_t& hits) {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    std::vector<ray> rays(count);
+    for (ray& r : rays) {
+        r = ray{{uniform(rng) * extent, uniform(rng) + 1.0, uniform(rng) * extent}, {uniform(rng), uniform(rng), uniform(rng)}};
+    }
+
+    hits = 0;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (const ray& r : rays) {
+        hit record;
+        if (world.is_hit(r, record, MINIMUM, INFINITY)) hits++;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start_time;
+
+    return count / elapsed.count() / 1e6;
+}
+
+/// @brief 用 PrecisionScene<T> 发射与 trace_primary 相同的主光线，光线在 T 精度下求交，返回每秒光线数 (百万)
+template <typename T>
+double trace_precision(const PrecisionScene<T>& scene, int width, int height, int repeat, size_t& hits) {
+    Camera camera({13, 2, 3}, {0, 0, 0}, {0, 1, 0}, 20.0, double(width) / height);
+    hits = 0;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < repeat; r++) {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                ray primary = camera.get_ray(double(x) / (width - 1), double(y) / (height - 1));
+                typename PrecisionScene<T>::nearest_hit found;
+                if (scene.nearest(ray_t<T>{vec3_t<T>(primary.origin), vec3_t<T>(primary.dir)}, T(0), T(INFINITY), found)) hits++;
+            }
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start_time;
+
+    return double(width) * height * repeat / elapsed.count() / 1e6;
+}
+
+/// @brief 用 LinearBVH 的无栈遍历发射与 trace_primary 相同的主光线，返回每秒光线数 (百万)
+/// @param in_flight 0 表示逐条光线遍历到底；否则同时维护 in_flight 条光线，每条每轮前进 slice 步后换下一条，
+/// 模拟 wavefront 调度器交替推进大量光线
+double trace_stackless(const LinearBVH& bvh, int width, int height, int in_flight, int slice, size_t& hits) {
+    Camera camera({13, 2, 3}, {0, 0, 0}, {0, 1, 0}, 20.0, double(width) / height);
+    std::vector<ray> rays;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) rays.push_back(camera.get_ray(double(x) / (width - 1), double(y) / (height - 1)));
+    }
+
+    hits = 0;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    if (in_flight == 0) {
+        for (const ray& r : rays) {
+            hit record;
+            if (bvh.is_hit_stackless(r, record, MINIMUM, INFINITY)) hits++;
+        }
+    } else {
+        // 每个槽位保存一条光线的固定大小状态，完成后立即装入下一条光线
+        std::vector<bvh_stackless_state> states(in_flight);
+        std::vector<hit_candidate> candidates(in_flight);
+        std::vector<size_t> slot_ray(in_flight);
+        size_t next = 0, active = 0;
+        for (int i = 0; i < in_flight && next < rays.size(); i++, active++) {
+            slot_ray[i] = next++;
+            states[i] = bvh.stackless_begin(INFINITY);
+        }
+        while (active > 0) {
+            for (int i = 0; i < in_flight; i++) {
+                if (states[i].finished) continue;
+                if (!bvh.stackless_resume(states[i], rays[slot_ray[i]], candidates[i], MINIMUM, slice)) continue;
+
+                if (states[i].hit_anything) {
+                    hit record;
+                    Hittable::finalize_candidate(rays[slot_ray[i]], candidates[i], record);
+                    hits++;
+                }
+                if (next < rays.size()) {
+                    slot_ray[i] = next++;
+                    states[i] = bvh.stackless_begin(INFINITY);
+                } else {
+                    active--;
+                }
+            }
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start_time;
+
+    return rays.size() / elapsed.count() / 1e6;
+}
+
+/// @brief 用 perf_event_open 统计一段代码中 L1 数据缓存与末级缓存的读缺失次数 (只计用户态)
+/// 非 Linux 平台或没有权限 (见 /proc/sys/kernel/perf_event_paranoid) 时 available() 为 false
+class cache_miss_counter {
+public:
+    cache_miss_counter() {
+#if defined(__linux__)
+        l1d = open_counter(PERF_COUNT_HW_CACHE_L1D);
+        llc = open_counter(PERF_COUNT_HW_CACHE_LL);
+#endif
+    }
+
+    ~cache_miss_counter() {
+#if defined(__linux__)
+        if (l1d >= 0) close(l1d);
+        if (llc >= 0) close(llc);
+#endif
+    }
+
+    bool available() const { return l1d >= 0 && llc >= 0; }
+
+    void start() {
+#if defined(__linux__)
+        for (int fd : {l1d, llc}) {
+            if (fd < 0) continue;
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    void stop() {
+#if defined(__linux__)
+        for (int fd : {l1d, llc}) {
+            if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+#endif
+    }
+
+    uint64_t l1d_misses() const { return value(l1d); }
+    uint64_t llc_misses() const { return value(llc); }
+
+private:
+    static uint64_t value(int fd) {
+        uint64_t count = 0;
+#if defined(__linux__)
+        if (fd >= 0 && ::read(fd, &count, sizeof(count)) != sizeof(count)) count = 0;
+#endif
+        return count;
+    }
+
+#if defined(__linux__)
+    static int open_counter(uint64_t cache) {
+        perf_event_attr attr{};
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.size = sizeof(attr);
+        attr.config = cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+
+    int l1d = -1;
+    int llc = -1;
+};
+
+void report(const char* name, double build_ms, const bvh_stats& stats, const std::vector<double>& mrays, size_t hits,
+    double visits_per_ray, double tests_per_ray) {
+    double mean = 0.0, variance = 0.0;
+    for (double m : mrays) mean += m;
+    mean /= mrays.size();
+    for (double m : mrays) variance += (m - mean) * (m - mean);
+    variance /= mrays.size();
+
+    printf("%-14s build %8.3f ms | nodes %7zu leaves %7zu depth %3zu | SAH cost %7.3f | %6.3f Mrays/s (stddev %.3f) | visits/ray %6.2f tests/ray %6.2f | hits %zu\n",
+        name, build_ms, stats.node_count, stats.leaf_count, stats.max_depth, stats.sah_cost, mean, std::sqrt(variance),
+        visits_per_ray, tests_per_ray, hits);
+}
+
+/// @brief 对一种加速结构重复构建 runs 次，统计构建时间与主光线吞吐量
+template <typename Accel>
+void benchmark(const char* name, const HittableList& balls, const bvh_build_options& options,
+    int width, int height, int runs) {
+    std::vector<double> mrays;
+    double build_ms = 0.0;
+    bvh_stats stats;
+    size_t hits = 0;
+    bvh_traversal_counters = bvh_traversal_stats();
+
+    for (int run = 0; run < runs; run++) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        Accel accel(balls, 0.0, 1.0, options);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start_time;
+
+        build_ms += elapsed.count() / runs;
+        stats = accel.stats(options);
+        mrays.push_back(trace_primary(accel, width, height, 4, hits));
+    }
+
+    double rays = double(width) * height * 4 * runs;
+    report(name, build_ms, stats, mrays, hits,
+        bvh_traversal_counters.node_visits / rays, bvh_traversal_counters.primitive_tests / rays);
+}
+
+int main(int argc, char** argv) {
+    const int width = 480;
+    const int height = 270;
+    const int runs = 5;
+    // 打开遍历计数，各 BVH 的统计输出依赖它
+    bvh_traversal_stats_enabled = true;
+
+    // 可选参数：网格半径，默认 11 对应 scene_test 的 480 个小球，500 约为一百万个小球
+    int grid = argc > 1 ? std::atoi(argv[1]) : 11;
+    // 第二个参数：三角形网格测试中圆环的细分数，三角形数为其平方，默认 400 约为十六万个，2000 为四百万个
+    int mesh_segments = argc > 2 ? std::atoi(argv[2]) : 400;
+
+    // 启动时按 CPUID 选择热点核心的指令集级别并打印，环境变量 RAGINE_ISA 可以强制指定较低的级别
+    active_kernels();
+
+    HittableList balls = random_balls(grid);
+    std::cout << "Benchmark scene: " << balls.get_size() << " spheres" << std::endl;
+
+    for (int leaf_size : {1, 4}) {
+        bvh_build_options options;
+        options.max_leaf_size = leaf_size;
+
+        char name[32];
+        snprintf(name, sizeof(name), "bvh_node/%d", leaf_size);
+        benchmark<bvh_node>(name, balls, options, width, height, runs);
+
+        snprintf(name, sizeof(name), "linear/%d", leaf_size);
+        benchmark<LinearBVH>(name, balls, options, width, height, runs);
+
+        snprintf(name, sizeof(name), "qbvh/%d", leaf_size);
+        benchmark<QBVH>(name, balls, options, width, height, runs);
+
+        snprintf(name, sizeof(name), "obvh/%d", leaf_size);
+        benchmark<OBVH>(name, balls, options, width, height, runs);
+
+        snprintf(name, sizeof(name), "compressed/%d", leaf_size);
+        benchmark<CompressedBVH>(name, balls, options, width, height, runs);
+    }
+
+    // 节点内存：压缩节点把子节点包围盒量化为 8 位，场景越大越能体现带宽上的优势
+    {
+        bvh_build_options options;
+        options.max_leaf_size = 4;
+        LinearBVH linear(balls, 0.0, 1.0, options);
+        OBVH wide(balls, 0.0, 1.0, options);
+        CompressedBVH compressed(balls, 0.0, 1.0, options);
+        printf("node memory: linear %.2f MB (%zu B/node) | obvh %.2f MB (%zu B/node) | compressed %.2f MB (%zu B/node)\n",
+            linear.nodes.size() * sizeof(linear_bvh_node) / 1048576.0, sizeof(linear_bvh_node),
+            wide.nodes.size() * sizeof(wide_bvh_node<8>) / 1048576.0, sizeof(wide_bvh_node<8>),
+            compressed.node_bytes() / 1048576.0, sizeof(compressed_bvh_node));
+    }
+
+    // 构建算法对比：Morton 码构建用于每帧重建，以少量质量换取构建速度
+    std::cout << "Builders (LinearBVH, leaf size 4):" << std::endl;
+    // 带 "+treelet" 的一行在构建后做 3 遍树片重构
+    const std::tuple<const char*, bvh_build_method, int> methods[] = {
+        {"sah", bvh_build_method::sah, 0},
+        {"sah+treelet", bvh_build_method::sah, 3},
+        {"lbvh", bvh_build_method::lbvh, 0},
+        {"lbvh+treelet", bvh_build_method::lbvh, 3},
+        {"hlbvh", bvh_build_method::hlbvh, 0},
+        {"hlbvh+treelet", bvh_build_method::hlbvh, 3}
+    };
+    for (const auto& [name, method, treelet_passes] : methods) {
+        bvh_build_options options;
+        options.max_leaf_size = 4;
+        options.method = method;
+        options.treelet_passes = treelet_passes;
+        benchmark<LinearBVH>(name, balls, options, width, height, runs);
+    }
+
+    // 节点排列顺序：树的结构相同，只改变节点在数组中的位置，场景越大 (超出末级缓存) 差别越明显
+    std::cout << "Node layouts (LinearBVH, leaf size 4, " << width * height << " primary + random rays):" << std::endl;
+    {
+        cache_miss_counter counter;
+        if (!counter.available()) std::cout << "cache miss counters n/a (perf_event_open unavailable)" << std::endl;
+
+        const std::tuple<const char*, bvh_layout> layouts[] = {
+            {"depth_first", bvh_layout::depth_first},
+            {"breadth_first", bvh_layout::breadth_first},
+            {"van_emde_boas", bvh_layout::van_emde_boas}
+        };
+        for (bvh_build_method method : {bvh_build_method::sah, bvh_build_method::lbvh}) {
+            for (const auto& [layout_name, layout] : layouts) {
+                bvh_build_options options;
+                options.max_leaf_size = 4;
+                options.method = method;
+                options.layout = layout;
+                LinearBVH accel(balls, 0.0, 1.0, options);
+
+                size_t primary_hits = 0, random_hits = 0;
+                double primary_mrays = trace_primary(accel, width, height, 1, primary_hits);
+
+                bvh_traversal_counters = bvh_traversal_stats();
+                size_t ray_count = size_t(width) * height;
+                counter.start();
+                double random_mrays = trace_random(accel, grid, ray_count, random_hits);
+                counter.stop();
+
+                char name[32];
+                snprintf(name, sizeof(name), "%s/%s", method == bvh_build_method::sah ? "sah" : "lbvh", layout_name);
+                printf("%-20s primary %6.3f Mrays/s (hits %zu) | random %6.3f Mrays/s (hits %zu) | visits/ray %6.2f",
+                    name, primary_mrays, primary_hits, random_mrays, random_hits, bvh_traversal_counters.node_visits / double(ray_count));
+                if (counter.available()) {
+                    printf(" | L1D miss/ray %6.2f LLC miss/ray %6.3f\n",
+                        counter.l1d_misses() / double(ray_count), counter.llc_misses() / double(ray_count));
+                } else {
+                    printf(" | L1D miss/ray n/a LLC miss/ray n/a\n");
+                }
+            }
+        }
+    }
+
+    // 无栈遍历：每条光线只保存固定大小的状态，可以随时暂停，代价是回溯时多经过内部节点
+    std::cout << "Stackless traversal (LinearBVH, leaf size 4):" << std::endl;
+    {
+        bvh_build_options options;
+        options.max_leaf_size = 4;
+        LinearBVH accel(balls, 0.0, 1.0, options);
+
+        size_t stack_hits = 0;
+        double stack_mrays = trace_primary(accel, width, height, 1, stack_hits);
+        printf("stack                 %6.3f Mrays/s | hits %zu\n", stack_mrays, stack_hits);
+
+        const std::tuple<const char*, int, int> modes[] = {
+            {"stackless", 0, 0},
+            {"stackless 64x16", 64, 16},
+            {"stackless 1024x16", 1024, 16}
+        };
+        for (const auto& [name, in_flight, slice] : modes) {
+            size_t hits = 0;
+            double mrays = trace_stackless(accel, width, height, in_flight, slice, hits);
+            printf("%-21s %6.3f Mrays/s | hits %zu | state %zu B/ray\n", name, mrays, hits, sizeof(bvh_stackless_state));
+        }
+    }
+
+    // 均匀网格与 kd 树：物体分布均匀、大小相近的场景中可能比 BVH 构建更快、遍历更快
+    std::cout << "Grid / kd-tree vs BVH:" << std::endl;
+    {
+        bvh_build_options options;
+        options.max_leaf_size = 4;
+        auto start_time = std::chrono::high_resolution_clock::now();
+        LinearBVH bvh(balls, 0.0, 1.0, options);
+        std::chrono::duration<double, std::milli> bvh_ms = std::chrono::high_resolution_clock::now() - start_time;
+
+        size_t bvh_hits = 0;
+        double bvh_mrays = trace_primary(bvh, width, height, 1, bvh_hits);
+        printf("linear/4        build %8.3f ms | %6.3f Mrays/s | hits %zu\n", bvh_ms.count(), bvh_mrays, bvh_hits);
+
+        for (double density : {1.0, 3.0, 8.0}) {
+            grid_options grid_settings;
+            grid_settings.density = density;
+            start_time = std::chrono::high_resolution_clock::now();
+            GridAccel grid_accel(balls, 0.0, 1.0, grid_settings);
+            std::chrono::duration<double, std::milli> grid_ms = std::chrono::high_resolution_clock::now() - start_time;
+
+            size_t grid_hits = 0;
+            double grid_mrays = trace_primary(grid_accel, width, height, 1, grid_hits);
+            printf("grid/%-4.0f       build %8.3f ms | %6.3f Mrays/s | hits %zu | %dx%dx%d cells (%zu occupied, %s)\n",
+                density, grid_ms.count(), grid_mrays, grid_hits, grid_accel.resolution[0], grid_accel.resolution[1],
+                grid_accel.resolution[2], grid_accel.occupied_cells(), grid_accel.hashed ? "hashed" : "dense");
+        }
+
+        for (int leaf_size : {1, 4}) {
+            kd_tree_options kd_settings;
+            kd_settings.max_leaf_size = leaf_size;
+            start_time = std::chrono::high_resolution_clock::now();
+            KdTree kd_tree(balls, 0.0, 1.0, kd_settings);
+            std::chrono::duration<double, std::milli> kd_ms = std::chrono::high_resolution_clock::now() - start_time;
+
+            size_t kd_hits = 0;
+            double kd_mrays = trace_primary(kd_tree, width, height, 1, kd_hits);
+            bvh_stats kd_stats = kd_tree.stats();
+            printf("kd-tree/%d       build %8.3f ms | %6.3f Mrays/s | hits %zu | nodes %zu (%.2f MB) leaves %zu depth %zu refs %zu\n",
+                leaf_size, kd_ms.count(), kd_mrays, kd_hits, kd_stats.node_count, kd_tree.nodes.size() * sizeof(kd_tree_node) / 1048576.0,
+                kd_stats.leaf_count, kd_stats.max_depth, kd_tree.primitive_indices.size());
+        }
+    }
+
+    // 球体批：SoA 存放的球一次 SIMD 指令求交多个，既可以直接做线性列表，也可以切成小批作为 BVH 叶子
+    std::cout << "SphereSet (" << cpu_isa_name(active_kernels().isa) << ", " << SphereSet::lanes()
+              << " spheres per instruction):" << std::endl;
+    {
+        SphereSet spheres(balls);
+        if (balls.get_size() <= 4096) {
+            size_t list_hits = 0, set_hits = 0;
+            double list_mrays = trace_primary(balls, width, height, 1, list_hits);
+            double set_mrays = trace_primary(spheres, width, height, 1, set_hits);
+            printf("linear list     %6.3f Mrays/s | hits %zu\n", list_mrays, list_hits);
+            printf("linear set      %6.3f Mrays/s | hits %zu\n", set_mrays, set_hits);
+        }
+
+        bvh_build_options options;
+        options.max_leaf_size = 4;
+        benchmark<LinearBVH>("spheres/4", balls, options, width, height, 3);
+
+        options.max_leaf_size = 1;
+        for (size_t cluster_size : {4, 8, 16}) {
+            HittableList clusters(spheres.clusters(cluster_size));
+            char name[32];
+            snprintf(name, sizeof(name), "set/%zu", cluster_size);
+            benchmark<LinearBVH>(name, clusters, options, width, height, 3);
+        }
+    }
+
+    // 标量精度：同一棵 LinearBVH，光线、几何与求交分别按 double 与 float 实例化
+    std::cout << "Precision (PrecisionScene, leaf size 4):" << std::endl;
+    {
+        bvh_build_options options;
+        options.max_leaf_size = 4;
+        PrecisionScene<double> scene_double(balls, options);
+        PrecisionScene<float> scene_float(balls, options);
+
+        size_t double_hits = 0, float_hits = 0;
+        double double_mrays = trace_precision(scene_double, width, height, 2, double_hits);
+        double float_mrays = trace_precision(scene_float, width, height, 2, float_hits);
+        printf("double %6.3f Mrays/s | hits %zu\n", double_mrays, double_hits);
+        printf("float  %6.3f Mrays/s | hits %zu | nodes %.2f MB\n", float_mrays, float_hits, scene_float.node_bytes() / 1048576.0);
+    }
+
+    // 三角形网格：OBJ 文件映射后分块并行解析，三角形按 BVH 叶子分批，批内 watertight 求交由运行时选择的核心向量化
+    std::cout << "Triangle mesh (OBJ load + BVH build, batched watertight test):" << std::endl;
+    {
+        const std::string path = "ppm/bin/bvh_benchmark_torus.obj";
+        if (!write_torus_obj(path, mesh_segments)) {
+            std::cout << "could not write " << path << std::endl;
+        }
+
+        auto material = std::make_shared<Lambertian>(Colors::Gray50);
+        for (bvh_build_method method : {bvh_build_method::sah, bvh_build_method::hlbvh}) {
+            bvh_build_options options = TriangleMesh::default_build_options();
+            options.method = method;
+
+            auto start_time = std::chrono::high_resolution_clock::now();
+            std::shared_ptr<TriangleMesh> mesh = load_obj(path, material, options);
+            std::chrono::duration<double, std::milli> load_ms = std::chrono::high_resolution_clock::now() - start_time;
+            if (!mesh) break;
+
+            bvh_traversal_counters = {};
+            size_t hits = 0;
+            double mrays = trace_primary(*mesh, width, height, 1, hits);
+            double rays = double(width) * height;
+            printf("%-6s %zu triangles | load %9.3f ms | %6.3f Mrays/s | hits %zu | nodes %.2f batches %.2f per ray\n",
+                method == bvh_build_method::sah ? "sah" : "hlbvh", mesh->triangle_count(), load_ms.count(), mrays, hits,
+                bvh_traversal_counters.node_visits / rays, bvh_traversal_counters.primitive_tests / rays);
+        }
+        std::remove(path.c_str());
+    }
+
+    // 自动选择：构建所有后端并用随机光线探测，保留最快的一个；再用主光线验证选择结果
+    std::cout << "Accelerator auto selection:" << std::endl;
+    {
+        Accelerator chosen(balls, 0.0, 1.0, "auto");
+        for (const auto& [name, build_ms, mrays] : chosen.stats().probes) {
+            printf("probe %-11s build %8.3f ms | %6.3f Mrays/s (random rays)\n", name.c_str(), build_ms, mrays);
+        }
+        size_t hits = 0;
+        double mrays = trace_primary(chosen, width, height, 1, hits);
+        printf("selected %s in %.3f ms | %6.3f Mrays/s (primary) | hits %zu\n",
+            chosen.stats().backend.c_str(), chosen.stats().build_ms, mrays, hits);
+    }
+
+    // 双层结构：同一簇小球作为 BLAS 只构建一次，在场景中以不同变换放置多次，与展开成单层 BVH 的结果对比
+    std::cout << "Instancing (TLAS over BLAS instances vs flattened BVH, leaf size 4):" << std::endl;
+    {
+        bvh_build_options options;
+        options.max_leaf_size = 4;
+
+        HittableList cluster;
+        auto material = std::make_shared<Lambertian>(Colors::Gray50);
+        for (int i = 0; i < 64; i++) {
+            cluster.add(std::make_shared<Sphere>(vec3{scene_random() * 2 - 1, scene_random() * 0.5, scene_random() * 2 - 1}, 0.1, material));
+        }
+        auto blas = std::make_shared<LinearBVH>(cluster, 0.0, 1.0, options);
+
+        HittableList instances, flattened;
+        for (int a = -10; a < 10; a++) {
+            for (int b = -10; b < 10; b++) {
+                affine_transform t = affine_transform::translate({a * 2.5, 0.0, b * 2.5})
+                                   * affine_transform::rotate({0, 1, 0}, scene_random() * 360.0);
+                instances.add(std::make_shared<Instance>(blas, t));
+                for (const auto& object : cluster.objects) {
+                    auto sphere = std::dynamic_pointer_cast<Sphere>(object);
+                    flattened.add(std::make_shared<Sphere>(t.point(sphere->center), sphere->radius, sphere->material));
+                }
+            }
+        }
+
+        LinearBVH tlas(instances, 0.0, 1.0, options);
+        LinearBVH flat(flattened, 0.0, 1.0, options);
+
+        size_t tlas_hits = 0, flat_hits = 0;
+        double tlas_mrays = trace_primary(tlas, width, height, 2, tlas_hits);
+        double flat_mrays = trace_primary(flat, width, height, 2, flat_hits);
+        printf("two-level: %zu instances, %zu nodes (TLAS %zu + BLAS %zu) | %6.3f Mrays/s | hits %zu\n",
+            instances.objects.size(), tlas.nodes.size() + blas->nodes.size(), tlas.nodes.size(), blas->nodes.size(), tlas_mrays, tlas_hits);
+        printf("flattened: %zu spheres,  %zu nodes | %6.3f Mrays/s | hits %zu\n",
+            flattened.objects.size(), flat.nodes.size(), flat_mrays, flat_hits);
+    }
+
+    // 阴影光线：any-hit 查询在第一个交点处停止，不计算交点属性
+    std::cout << "Shadow rays (ground plane + spheres, leaf size 4):" << std::endl;
+    {
+        bvh_build_options options;
+        options.max_leaf_size = 4;
+
+        HittableList objects = balls;
+        objects.add(std::make_shared<Plane>(vec3{0, 0, 0}, vec3{0, 1, 0}, std::make_shared<Lambertian>(Colors::Gray50)));
+        Scene scene(objects, 0.0, 1.0, options);
+
+        size_t closest_blocked = 0, any_blocked = 0;
+        double closest_mrays = trace_shadow(scene, width, height, false, closest_blocked);
+        double any_mrays = trace_shadow(scene, width, height, true, any_blocked);
+        printf("is_hit      %6.3f Mrays/s | blocked %zu\n", closest_mrays, closest_blocked);
+        printf("is_occluded %6.3f Mrays/s | blocked %zu\n", any_mrays, any_blocked);
+    }
+
+    // 运动模糊：小球在快门时间内匀速移动，静态 BVH 只能用覆盖整个快门的包围盒，运动 BVH 按光线时刻插值节点包围盒
+    std::cout << "Motion blur (moving spheres, shutter [0, 1], leaf size 4):" << std::endl;
+    {
+        bvh_build_options options;
+        options.max_leaf_size = 4;
+
+        for (double speed : {0.5, 2.0}) {
+            HittableList moving;
+            for (const auto& object : balls.objects) {
+                auto sphere = std::dynamic_pointer_cast<Sphere>(object);
+                vec3 offset{(scene_random() * 2 - 1) * speed, 0.0, (scene_random() * 2 - 1) * speed};
+                moving.add(std::make_shared<MovingSphere>(sphere->center, sphere->center + offset, 0.0, 1.0,
+                    sphere->radius, sphere->material));
+            }
+
+            auto start_time = std::chrono::high_resolution_clock::now();
+            LinearBVH linear(moving, 0.0, 1.0, options);
+            std::chrono::duration<double, std::milli> linear_ms = std::chrono::high_resolution_clock::now() - start_time;
+            start_time = std::chrono::high_resolution_clock::now();
+            MotionBVH motion(moving, 0.0, 1.0, options);
+            std::chrono::duration<double, std::milli> motion_ms = std::chrono::high_resolution_clock::now() - start_time;
+
+            const std::tuple<const char*, const Hittable*, double> accels[] = {
+                {"linear", &linear, linear_ms.count()},
+                {"motion", &motion, motion_ms.count()}
+            };
+            size_t reference_hits = 0;
+            for (const auto& [name, accel, build_ms] : accels) {
+                bvh_traversal_counters = {};
+                size_t hits = 0;
+                // 光线时刻来自 random_double，两种结构用同一个种子发射完全相同的光线，命中数必须一致
+                random_seed(7);
+                double mrays = trace_primary(*accel, width, height, 1, hits, 1.0);
+                double rays = double(width) * height;
+                printf("%-6s speed %.1f | build %8.3f ms | %6.3f Mrays/s | hits %zu | visits/ray %6.2f tests/ray %6.2f\n",
+                    name, speed, build_ms, mrays, hits, bvh_traversal_counters.node_visits / rays,
+                    bvh_traversal_counters.primitive_tests / rays);
+                if (accel == &linear) {
+                    reference_hits = hits;
+                } else if (hits != reference_hits) {
+                    std::cerr << "WARNING: " << name << " hits " << hits << " differ from linear " << reference_hits << ".\n";
+                }
+            }
+        }
+    }
+
+    // 运行时分发：依次切换到 CPU 支持的每个指令集级别，结构只构建一次，各级别的命中数与转换结果应当相同
+    std::cout << "CPU dispatch (detected " << cpu_isa_name(detect_cpu_isa()) << ", leaf size 4):" << std::endl;
+    {
+        bvh_build_options options;
+        options.max_leaf_size = 4;
+        OBVH wide(balls, 0.0, 1.0, options);
+        CompressedBVH compressed(balls, 0.0, 1.0, options);
+        options.max_leaf_size = 1;
+        LinearBVH sets(HittableList(SphereSet(balls).clusters(8)), 0.0, 1.0, options);
+
+        const std::string path = "ppm/bin/bvh_benchmark_dispatch.obj";
+        std::shared_ptr<TriangleMesh> mesh;
+        if (write_torus_obj(path, 200)) mesh = load_obj(path, std::make_shared<Lambertian>(Colors::Gray50));
+        std::remove(path.c_str());
+
+        // 像素转换：颜色略超出 [0, 1]，覆盖两端的截断
+        std::mt19937 pixel_rng(7);
+        std::uniform_real_distribution<double> channel(-0.05, 1.05);
+        std::vector<vec3> image(size_t(width) * height);
+        for (vec3& pixel : image) pixel = vec3{channel(pixel_rng), channel(pixel_rng), channel(pixel_rng)};
+        std::vector<uint8_t> bytes(image.size() * 3);
+
+        cpu_isa previous = active_kernels().isa;
+        for (int level = 0; level <= (int)detect_cpu_isa(); level++) {
+            cpu_isa isa = set_cpu_isa((cpu_isa)level);
+            size_t wide_hits = 0, compressed_hits = 0, set_hits = 0, mesh_hits = 0;
+            double wide_mrays = trace_primary(wide, width, height, 1, wide_hits);
+            double compressed_mrays = trace_primary(compressed, width, height, 1, compressed_hits);
+            double set_mrays = trace_primary(sets, width, height, 1, set_hits);
+            double mesh_mrays = mesh ? trace_primary(*mesh, width, height, 1, mesh_hits) : 0.0;
+
+            const int repeat = 20;
+            auto start_time = std::chrono::high_resolution_clock::now();
+            for (int r = 0; r < repeat; r++) {
+                active_kernels().float_to_rgb8(&image[0].x, sizeof(vec3) / sizeof(double), image.size(), bytes.data());
+            }
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start_time;
+            size_t checksum = 0;
+            for (uint8_t b : bytes) checksum += b;
+
+            printf("%-8s obvh %6.3f | compressed %6.3f | set/8 %6.3f | mesh %6.3f Mrays/s | hits %zu %zu %zu %zu | "
+                "rgb8 %7.1f Mpixels/s (sum %zu)\n", cpu_isa_name(isa), wide_mrays, compressed_mrays, set_mrays, mesh_mrays,
+                wide_hits, compressed_hits, set_hits, mesh_hits, repeat * image.size() / elapsed.count() / 1e6, checksum);
+        }
+        set_cpu_isa(previous);
+    }
+
+    // 动画场景：小球逐帧移动，比较 refit 与完全重建的耗时，以及 refit 后树质量的变化
+    std::cout << "Refit vs rebuild (LinearBVH, leaf size 4):" << std::endl;
+    bvh_build_options options;
+    options.max_leaf_size = 4;
+    LinearBVH animated(balls, 0.0, 1.0, options);
+
+    for (int frame = 1; frame <= 5; frame++) {
+        for (auto& object : balls.objects) {
+            if (auto sphere = std::dynamic_pointer_cast<Sphere>(object)) {
+                sphere->center = sphere->center + vec3{0.1 * std::sin(sphere->center.z), 0.0, 0.1 * std::cos(sphere->center.x)};
+            }
+        }
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+        double quality = animated.refit();
+        std::chrono::duration<double, std::milli> refit_ms = std::chrono::high_resolution_clock::now() - start_time;
+
+        start_time = std::chrono::high_resolution_clock::now();
+        LinearBVH rebuilt(balls, 0.0, 1.0, options);
+        std::chrono::duration<double, std::milli> rebuild_ms = std::chrono::high_resolution_clock::now() - start_time;
+
+        size_t refit_hits = 0, rebuilt_hits = 0;
+        double refit_mrays = trace_primary(animated, width, height, 1, refit_hits);
+        double rebuilt_mrays = trace_primary(rebuilt, width, height, 1, rebuilt_hits);
+
+        printf("frame %d: refit %8.3f ms (SAH x%.3f, %6.3f Mrays/s, hits %zu) | rebuild %8.3f ms (%6.3f Mrays/s, hits %zu)\n",
+            frame, refit_ms.count(), quality, refit_mrays, refit_hits, rebuild_ms.count(), rebuilt_mrays, rebuilt_hits);
+    }
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "ragine.h"
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <omp.h>
+
+// 精度对比：同一场景分别用引擎 (double + MINIMUM)、PrecisionScene<double> 与 PrecisionScene<float> 渲染
+// 比较渲染时间与相对引擎结果的均方根误差，图片写入 ppm/bin/precision_*.ppm 以便直接比较画质
+
+/// @brief 与 scene_test 相同布局的随机球场景，整体平移 shift，用于观察远离原点时 float 精度的表现
+HittableList precision_world(const vec3& shift) {
+    HittableList world;
+    random_seed(42);
+
+    auto checker = std::make_shared<CheckerTexture>(vec3{0.0, 0.0, 0.0}, vec3{0.9, 0.9, 0.9});
+    world.add(std::make_shared<Plane>(shift, vec3{0, 1, 0}, std::make_shared<Lambertian>(checker)));
+
+    for (int a = -11; a < 11; a++) {
+        for (int b = -11; b < 11; b++) {
+            double choose_mat = random_double();
+            vec3 center{a + 0.9 * random_double(), 0.2, b + 0.9 * random_double()};
+            if ((center - vec3{4, 0.2, 0}).length() <= 0.9) continue;
+
+            std::shared_ptr<Material> material;
+            if (choose_mat < 0.8) {
+                material = std::make_shared<Lambertian>(vec3_random() * vec3_random());
+            } else if (choose_mat < 0.95) {
+                material = std::make_shared<Metal>(vec3_random(0.5, 1), random_double(0, 0.5));
+            } else {
+                material = std::make_shared<Dielectric>(vec3{1.0, 1.0, 1.0}, 1.5);
+            }
+            world.add(std::make_shared<Sphere>(center + shift, 0.2, material));
+        }
+    }
+
+    world.add(std::make_shared<Sphere>(vec3{0, 1, 0} + shift, 1.0, std::make_shared<Dielectric>(vec3{1.0, 1.0, 1.0}, 1.5)));
+    world.add(std::make_shared<Sphere>(vec3{4, 1, 2} + shift, 1.0, std::make_shared<Lambertian>(vec3{0.4, 0.2, 0.1})));
+    world.add(std::make_shared<Sphere>(vec3{4, 1, 0} + shift, 1.0, std::make_shared<Metal>(vec3{0.7, 0.6, 0.5}, 0.0)));
+    return world;
+}
+
+/// @brief 渲染一张图片，返回渲染时间 (秒)
+double render(std::vector<vec3>& image, int width, int height, int samples_per_pixel, Camera& camera,
+    const std::function<vec3(const ray&)>& trace) {
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    #pragma omp parallel for collapse(2) schedule(dynamic)
+    for (int y = height - 1; y > -1; y--) {
+        for (int x = 0; x < width; x++) {
+            vec3 pixel_color = {0, 0, 0};
+            for (int s = 0; s < samples_per_pixel; ++s) {
+                double u = (double(x) + random_double()) / (width - 1);
+                double v = (double(height - 1 - y) + random_double()) / (height - 1);
+                pixel_color = pixel_color + trace(camera.get_ray(u, v));
+            }
+            image[y * width + x] = sampled_gamma(pixel_color, samples_per_pixel);
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start_time;
+    return elapsed.count();
+}
+
+double rmse(const std::vector<vec3>& a, const std::vector<vec3>& b) {
+    double sum = 0.0;
+    for (size_t i = 0; i < a.size(); i++) sum += (a[i] - b[i]).length_squared();
+    return std::sqrt(sum / (3.0 * a.size()));
+}
+
+int main(int argc, char** argv) {
+    const int width = 480;
+    const int height = 270;
+    // 可选参数：场景平移距离 (默认 0)，例如 10000 可以看到远离原点时 float 的误差
+    const double shift = argc > 1 ? std::atof(argv[1]) : 0.0;
+    // 第二个参数：每像素采样数
+    const int samples_per_pixel = argc > 2 ? std::atoi(argv[2]) : 32;
+    const int max_depth = 50;
+
+    HittableList objects = precision_world(vec3{shift, 0.0, shift});
+    Accelerator engine(objects, 0.0, 1.0, "bvh");
+    PrecisionScene<double> scene_double(objects);
+    PrecisionScene<float> scene_float(objects);
+    std::cout << objects.get_size() << " objects, scene shifted by " << shift << ", " << samples_per_pixel
+              << " samples per pixel, " << omp_get_max_threads() << " threads" << std::endl;
+    std::cout << "BVH nodes: " << scene_float.node_bytes() / 1024.0 << " KB (LinearBVH, shared layout for both precisions)" << std::endl;
+
+    Camera camera(vec3{13 + shift, 2, 3 + shift}, vec3{shift, 0, shift}, {0, 1, 0}, 20.0, double(width) / height, 10.0);
+
+    std::vector<vec3> reference(width * height), image_double(width * height), image_float(width * height);
+    double engine_s = render(reference, width, height, samples_per_pixel, camera, [&](const ray& r) {
+        return ray_color(r, engine, max_depth);
+    });
+    double double_s = render(image_double, width, height, samples_per_pixel, camera, [&](const ray& r) {
+        return ray_color(r, scene_double, max_depth, true);
+    });
+    double float_s = render(image_float, width, height, samples_per_pixel, camera, [&](const ray& r) {
+        return ray_color(rayf{vec3f(r.origin), vec3f(r.dir), r.time}, scene_float, max_depth, true);
+    });
+
+    printf("engine (double, MINIMUM)   %8.3f s\n", engine_s);
+    printf("PrecisionScene<double>     %8.3f s | RMSE vs engine %.5f\n", double_s, rmse(reference, image_double));
+    printf("PrecisionScene<float>      %8.3f s | RMSE vs engine %.5f | RMSE vs double %.5f\n",
+        float_s, rmse(reference, image_float), rmse(image_double, image_float));
+
+    write_ppm("ppm/bin/precision_engine.ppm", reference, width, height);
+    write_ppm("ppm/bin/precision_double.ppm", image_double, width, height);
+    write_ppm("ppm/bin/precision_float.ppm", image_float, width, height);
+    std::cout << "Done! Generated ppm/bin/precision_{engine,double,float}.ppm" << std::endl;
+    return 0;
+}
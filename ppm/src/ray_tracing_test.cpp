@@ -66,16 +66,7 @@ int main() {
     std::chrono::duration<double> elapsed = end_time - start_time;
     std::cout << "Render time: " << elapsed.count() << "s" << std::endl;
 
-    std::ofstream ofs(file_path, std::ios::binary);
-    ofs << "P6\n" << width << " " << height << "\n255\n";
-
-    for (const auto& col : image_buffer) {
-         ofs << (unsigned char)(255.99 * std::min(0.999, std::max(0.0, col.x)))
-             << (unsigned char)(255.99 * std::min(0.999, std::max(0.0, col.y)))
-             << (unsigned char)(255.99 * std::min(0.999, std::max(0.0, col.z)));
-    }
-
-    ofs.close();
+    write_ppm(file_path, image_buffer, width, height);
     std::cout << "Done! Generated " << file_path << std::endl;
 
     return 0;
@@ -7,6 +7,9 @@ int main() {
     const int width = 800;
     const int height = 600;
 
+    // 渲染开始前打印运行时选择的指令集级别
+    active_kernels();
+
     // 多线程像素处理缓存
     std::vector<vec3> image_buffer(width * height);
 
@@ -19,6 +22,8 @@ int main() {
     auto material_fullmetal = std::make_shared<Metal>(vec3{0.8, 0.8, 0.8}, 0.0);
     // 右边球：金属 fuzz=0.5
     auto material_halfmetal = std::make_shared<Metal>(vec3{0.8, 0.6, 0.2}, 0.5);
+    // 运动球：蓝色漫反射
+    auto material_blue = std::make_shared<Lambertian>(vec3{0.2, 0.3, 0.8});
 
     // Scenario Definition
     HittableList world(std::vector<std::shared_ptr<Hittable>> {
@@ -31,6 +36,14 @@ int main() {
     // Camera Definition
     vec3 camera_up = { 0.0, 1.0, 0.0 };
 
+    // 运动球的轨迹：绕中间球做圆周运动，时刻以帧为单位
+    auto moving_ball_center = [](double time, int total) {
+        double theta = time / total * 16.0 * M_PI;
+        return vec3{1.6 * std::sin(theta), -0.3, -1.0 + 1.6 * std::cos(theta)};
+    };
+    // 快门在每帧开始时开启，保持半帧
+    const double shutter = 0.5;
+
     // Ray Tracing Definition
     const int max_depth = 50;
     const int samples_per_pixel = 200;
@@ -66,6 +79,14 @@ int main() {
         // C. 更新摄像机
         // 每次循环都用新的位置实例化摄像机
         Camera camera(lookfrom, world.get_object(1)->get_position(), camera_up, 60.0, double(width)/double(height) );
+        double time0 = frame, time1 = frame + shutter;
+        camera.set_shutter(time0, time1);
+
+        // D. 加入本帧快门时间内的运动球，用运动 BVH 组织场景
+        HittableList frame_world = world;
+        frame_world.add(std::make_shared<MovingSphere>(moving_ball_center(time0, total_frames),
+            moving_ball_center(time1, total_frames), time0, time1, 0.2, material_blue));
+        Accelerator scene(frame_world, time0, time1, "motion_bvh");
 
         #pragma omp parallel for collapse(2)
         for (int y = height - 1; y > -1; y--) {
@@ -80,7 +101,7 @@ int main() {
                     ray r = camera.get_ray(u, v);
                     
                     // 累加颜色
-                    pixel_color = pixel_color + ray_color(r, world, max_depth);
+                    pixel_color = pixel_color + ray_color(r, scene, max_depth);
                 }
 
                 image_buffer[y * width + x] = sampled_gamma(pixel_color, samples_per_pixel);
@@ -91,16 +112,7 @@ int main() {
         std::chrono::duration<double> elapsed = end_time - start_time;
         std::cout << "Render time: " << elapsed.count() << "s" << std::endl;
 
-        std::ofstream ofs(file_path, std::ios::binary);
-        ofs << "P6\n" << width << " " << height << "\n255\n";
-
-        for (const auto& col : image_buffer) {
-            ofs << (unsigned char)(255.99 * std::min(0.999, std::max(0.0, col.x)))
-                << (unsigned char)(255.99 * std::min(0.999, std::max(0.0, col.y)))
-                << (unsigned char)(255.99 * std::min(0.999, std::max(0.0, col.z)));
-        }
-
-        ofs.close();
+        write_ppm(file_path, image_buffer, width, height);
 
         if (frame % 10 == 0) {
             std::cout << "Rendered frame " << frame << " / " << total_frames << "\r" << std::flush;
@@ -45,9 +45,8 @@ int main() {
                 shadow_ray.origin = rec.position;
                 shadow_ray.dir = light_dir;
 
-                hit_legend shadow_rec;
                 double light_distance = (light_pos - rec.position).length();
-                bool in_shadow = world.is_hit(shadow_ray, shadow_rec, MINIMUM, light_distance);
+                bool in_shadow = world.is_occluded(shadow_ray, MINIMUM, light_distance);
 
                 if (in_shadow) {
                     color = rec.color * 0.02;
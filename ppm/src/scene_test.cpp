@@ -1,4 +1,5 @@
 #include "ragine.h"
+#include <chrono>
 #include <omp.h>
 
 HittableList random_world() {
@@ -8,8 +9,6 @@ HittableList random_world() {
     auto ground_material = std::make_shared<Lambertian>(checker);
     world.add(std::make_shared<Plane>(vec3{0, 0, 0}, vec3{0, 1, 0}, ground_material));
 
-    HittableList balls_list;
-
     for (int a = -11; a < 11; a++) {
         for (int b = -11; b < 11; b++) {
             // 随机位置
@@ -25,17 +24,17 @@ HittableList random_world() {
                     // 颜色向量相乘 = 使得颜色更柔和/偏暗，减少刺眼的亮色
                     auto albedo = vec3_random() * vec3_random();
                     sphere_material = std::make_shared<Lambertian>(albedo);
-                    balls_list.add(std::make_shared<Sphere>(center, 0.2, sphere_material));
+                    world.add(std::make_shared<Sphere>(center, 0.2, sphere_material));
                 } else if (choose_mat < 0.95) {
                     // 金属 (15% 概率)
                     auto albedo = vec3_random(0.5, 1); // 金属颜色通常较亮
                     auto fuzz = random_double(0, 0.5);
                     sphere_material = std::make_shared<Metal>(albedo, fuzz);
-                    balls_list.add(std::make_shared<Sphere>(center, 0.2, sphere_material));
+                    world.add(std::make_shared<Sphere>(center, 0.2, sphere_material));
                 } else {
                     // 玻璃 (5% 概率)
                     sphere_material = std::make_shared<Dielectric>(vec3{1.0, 1.0, 1.0}, 1.5);
-                    balls_list.add(std::make_shared<Sphere>(center, 0.2, sphere_material));
+                    world.add(std::make_shared<Sphere>(center, 0.2, sphere_material));
                 }
             }
         }
@@ -44,43 +43,51 @@ HittableList random_world() {
     // 3. 三个大球
     // 玻璃球
     auto material1 = std::make_shared<Dielectric>(vec3{1.0, 1.0, 1.0}, 1.5);
-    balls_list.add(std::make_shared<Sphere>(vec3{0, 1, 0}, 1.0, material1));
+    world.add(std::make_shared<Sphere>(vec3{0, 1, 0}, 1.0, material1));
 
     // 漫反射球
     auto earth_texture = std::make_shared<ImageTexture>("ppm/res/earth_texture.jpg", vec2{1.0, 1.0}, vec2{0.25, 0.0});
     auto earth_surface = std::make_shared<Lambertian>(earth_texture);
 
     auto material2 = std::make_shared<Lambertian>(vec3{0.4, 0.2, 0.1});
-    balls_list.add(std::make_shared<Sphere>(vec3{4, 1, 2}, 1.0, earth_surface));
+    world.add(std::make_shared<Sphere>(vec3{4, 1, 2}, 1.0, earth_surface));
 
     // 金属球
     auto material3 = std::make_shared<Metal>(vec3{0.7, 0.6, 0.5}, 0.0);
-    balls_list.add(std::make_shared<Sphere>(vec3{4, 1, 0}, 1.0, material3));
-
-    std::cout << "Creating BVH from " << balls_list.objects.size() << " spheres..." << std::endl;
-    
-    if (balls_list.objects.empty()) {
-        std::cerr << "ERROR: balls_list is empty!" << std::endl;
-    }
-
-    auto bvh_root = std::make_shared<bvh_node>(balls_list, 0.0, 1.0);
-    world.add(bvh_root);
-
-    std::cout << "BVH Root Box: " 
-              << "Min(" << bvh_root->box.minimum.x << ", " << bvh_root->box.minimum.y << ", " << bvh_root->box.minimum.z << ") "
-              << "Max(" << bvh_root->box.maximum.x << ", " << bvh_root->box.maximum.y << ", " << bvh_root->box.maximum.z << ")" 
-              << std::endl;
+    world.add(std::make_shared<Sphere>(vec3{4, 1, 0}, 1.0, material3));
 
     return world;
 }
 
-int main() {
+int main(int argc, char** argv) {
     const int width = 1920;
     const int height = 1080;
     const char* file_path = "ppm/bin/final_scene.ppm";
+    // 可选参数：加速结构后端名称 (linear / bvh / obvh / compressed / grid / kd_tree / auto)，默认 bvh，
+    // auto 按计时选择，每次运行的结果可能不同
+    const std::string backend = argc > 1 ? argv[1] : "bvh";
+
+    // 选择指令集级别并打印，可以用 RAGINE_ISA=sse4.2 等强制指定
+    active_kernels();
 
     std::cout << "Generating scene..." << std::endl;
-    HittableList world = random_world();
+    // 固定种子使每次运行生成同一个场景，BVH 可以直接从 ppm/bin 下的缓存加载
+    random_seed(42);
+    HittableList objects = random_world();
+
+    accel_options options;
+    options.bvh.cache_directory = "ppm/bin";
+
+    // 地面是无限平面，各后端都会把它单独测试，其余球体放进加速结构
+    std::cout << "Building " << backend << " accelerator from " << objects.get_size() << " objects..." << std::endl;
+    Accelerator world(objects, 0.0, 1.0, backend, options);
+    const accel_stats& stats = world.stats();
+    for (const auto& [name, build_ms, mrays] : stats.probes) {
+        std::cout << "  probe " << name << ": build " << build_ms << " ms, " << mrays << " Mrays/s" << std::endl;
+    }
+    std::cout << "Accelerator: " << stats.backend << (stats.cached ? " loaded from cache" : " built")
+              << " in " << stats.build_ms << " ms, " << stats.structure.node_count << " nodes, depth "
+              << stats.structure.max_depth << std::endl;
 
     vec3 lookfrom = {13, 2, 3};
     vec3 lookat = {0, 0, 0};
@@ -96,7 +103,7 @@ int main() {
     // 多线程处理
     std::vector<vec3> image_buffer(width * height);
     
-    std::cout << "Start rendering " << world.get_size() << " objects with " << omp_get_max_threads() << " threads..." << std::endl;
+    std::cout << "Start rendering " << objects.get_size() << " objects with " << omp_get_max_threads() << " threads..." << std::endl;
     auto start_time = std::chrono::high_resolution_clock::now();
 
     #pragma omp parallel for collapse(2) schedule(dynamic) // dynamic 调度有助于负载均衡
@@ -117,16 +124,7 @@ int main() {
     std::chrono::duration<double> elapsed = end_time - start_time;
     std::cout << "Render time: " << elapsed.count() << "s" << std::endl;
 
-    std::ofstream ofs(file_path, std::ios::binary);
-    ofs << "P6\n" << width << " " << height << "\n255\n";
-
-    for (const auto& col : image_buffer) {
-         ofs << (unsigned char)(255.99 * std::min(0.999, std::max(0.0, col.x)))
-             << (unsigned char)(255.99 * std::min(0.999, std::max(0.0, col.y)))
-             << (unsigned char)(255.99 * std::min(0.999, std::max(0.0, col.z)));
-    }
-
-    ofs.close();
+    write_ppm(file_path, image_buffer, width, height);
     std::cout << "Done! Generated " << file_path << std::endl;
 
     return 0;
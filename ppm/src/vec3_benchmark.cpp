@@ -0,0 +1,67 @@
+#include "ragine.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// vec3 微基准：测量 reflect、refract、向量基本运算与 legend 着色器每次调用的耗时
+// 分别用默认设置与 -DRAGINE_SIMD_VEC3 (ragine/src 也要一起重新编译) 构建两次，对比两种 vec3 实现
+// 输入使用固定种子生成，两次构建的输入完全相同，checksum 用于确认结果一致 (SIMD 版本的 normalize 可能有末位差异)
+
+/// @brief 对 count 个输入重复调用 kernel repeat 轮，返回每次调用的纳秒数
+template <typename Kernel>
+double measure(const char* name, size_t count, int repeat, Kernel&& kernel) {
+    double checksum = 0.0;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < repeat; r++) {
+        for (size_t i = 0; i < count; i++) checksum += kernel(i);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::high_resolution_clock::now() - start_time;
+    double ns = elapsed.count() / (double(count) * repeat);
+    printf("%-20s %7.3f ns/call | checksum %.6e\n", name, ns, checksum);
+    return ns;
+}
+
+int main(int argc, char** argv) {
+    // 可选参数：重复轮数，默认 2000
+    const int repeat = argc > 1 ? std::atoi(argv[1]) : 2000;
+    // 输入数量较少，全部留在缓存中，测量的是运算本身而不是内存带宽
+    const size_t count = 1 << 10;
+
+#if defined(RAGINE_SIMD_VEC3)
+    printf("vec3: SIMD (%zu bytes, aligned to %zu)\n", sizeof(vec3), alignof(vec3));
+#else
+    printf("vec3: scalar (%zu bytes, aligned to %zu)\n", sizeof(vec3), alignof(vec3));
+#endif
+
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    auto random_vec = [&]() { return vec3{uniform(rng), uniform(rng), uniform(rng)}; };
+
+    std::vector<vec3> directions(count), normals(count), lights(count), colors(count);
+    std::vector<hit_legend> records(count);
+    for (size_t i = 0; i < count; i++) {
+        directions[i] = random_vec().normalize();
+        normals[i] = random_vec().normalize();
+        // 让入射方向与法线相对，模拟光线打到表面的情形
+        if (directions[i].dot(normals[i]) > 0) normals[i] = normals[i] * -1.0;
+        lights[i] = random_vec() * 10.0;
+        colors[i] = (random_vec() + vec3{1, 1, 1}) * 127.5;
+        records[i] = {random_vec(), normals[i], colors[i], 1.0};
+    }
+    const vec3 camera_pos{0.0, 0.0, 5.0};
+
+    measure("dot", count, repeat, [&](size_t i) { return directions[i].dot(normals[i]); });
+    measure("cross", count, repeat, [&](size_t i) { return directions[i].cross(normals[i]).x; });
+    measure("normalize", count, repeat, [&](size_t i) { return lights[i].normalize().y; });
+    measure("reflect", count, repeat, [&](size_t i) { return reflect(directions[i], normals[i]).z; });
+    measure("refract", count, repeat, [&](size_t i) { return refract(directions[i], normals[i], 1.0 / 1.5).z; });
+    measure("lambert", count, repeat, [&](size_t i) { return lambert_shader(records[i], lights[i], colors[i]).x; });
+    measure("half_lambert", count, repeat, [&](size_t i) { return half_lambert_shader(records[i], lights[i], colors[i]).x; });
+    measure("phong", count, repeat, [&](size_t i) {
+        return phong_shader(records[i], lights[i], camera_pos, colors[i], 32.0).x;
+    });
+    measure("blinn_phong", count, repeat, [&](size_t i) {
+        return blinn_phong_shader(records[i], lights[i], camera_pos, colors[i], 32.0).x;
+    });
+    return 0;
+}
@@ -90,11 +90,10 @@ int main() {
                     shadow_ray.origin = rec.position; 
                     shadow_ray.dir = light_dir;
 
-                    hit_legend shadow_rec;
                     double light_distance = (light_pos - rec.position).length();
                     
                     // 检查是否在阴影中
-                    bool in_shadow = world.is_hit(shadow_ray, shadow_rec, MINIMUM, light_distance);
+                    bool in_shadow = world.is_occluded(shadow_ray, MINIMUM, light_distance);
 
                     if (in_shadow) {
                         color = rec.color * 0.02; // 环境光 (调亮一点点防止死黑)
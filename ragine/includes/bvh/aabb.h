@@ -2,21 +2,23 @@
 
 #include "ragine.h"
 
-class aabb {
+/// @brief 轴对齐包围盒，与 vec3_t 一样按标量类型模板化，aabb 为 double 版本
+template <typename T>
+class aabb_t {
 public:
-    vec3 minimum;
-    vec3 maximum;
+    vec3_t<T> minimum;
+    vec3_t<T> maximum;
     
-    aabb() {}
-    aabb(const vec3& min, const vec3& max): minimum(min), maximum(max) {}
+    aabb_t() {}
+    aabb_t(const vec3_t<T>& min, const vec3_t<T>& max): minimum(min), maximum(max) {}
 
-    bool is_hit(const ray& r, double t_entry, double t_leave) const {
+    bool is_hit(const ray_t<T>& r, T t_entry, T t_leave) const {
         for (int axis = 0; axis < 3; axis++) {
-            double invD = 1.0 / r.dir[axis];
-            double t0 = (minimum[axis] - r.origin[axis]) * invD;
-            double t1 = (maximum[axis] - r.origin[axis]) * invD;
+            T invD = T(1) / r.dir[axis];
+            T t0 = (minimum[axis] - r.origin[axis]) * invD;
+            T t1 = (maximum[axis] - r.origin[axis]) * invD;
 
-            if (invD < 0.0) {
+            if (invD < 0) {
                 std::swap(t0, t1);
             }
 
@@ -27,20 +29,53 @@ public:
         }
         return true;
     }
+
+    /// @brief 包围盒表面积 (用于 SAH 代价估计)
+    T surface_area() const {
+        vec3_t<T> d = maximum - minimum;
+        return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    vec3_t<T> centroid() const { return (minimum + maximum) * T(0.5); }
+
+    /// @brief 返回跨度最大的轴 (0: x, 1: y, 2: z)
+    int longest_axis() const {
+        vec3_t<T> d = maximum - minimum;
+        if (d.x > d.y && d.x > d.z) return 0;
+        return d.y > d.z ? 1 : 2;
+    }
 };
 
-inline aabb surrounding_box(const aabb& box0, const aabb& box1) {
-        vec3 small{
-            fmin(box0.minimum.x, box1.minimum.x),
-            fmin(box0.minimum.y, box1.minimum.y),
-            fmin(box0.minimum.z, box1.minimum.z)
+using aabb = aabb_t<double>;
+using aabbf = aabb_t<float>;
+
+/// @brief 空包围盒，与任意包围盒合并后得到该包围盒本身
+template <typename T = double>
+inline aabb_t<T> empty_box() {
+    return aabb_t<T>(vec3_t<T>{INFINITY, INFINITY, INFINITY}, vec3_t<T>{-INFINITY, -INFINITY, -INFINITY});
+}
+
+template <typename T>
+inline aabb_t<T> surrounding_box(const aabb_t<T>& box, const vec3_t<T>& point) {
+    return aabb_t<T>(
+        vec3_t<T>{std::min(box.minimum.x, point.x), std::min(box.minimum.y, point.y), std::min(box.minimum.z, point.z)},
+        vec3_t<T>{std::max(box.maximum.x, point.x), std::max(box.maximum.y, point.y), std::max(box.maximum.z, point.z)}
+    );
+}
+
+template <typename T>
+inline aabb_t<T> surrounding_box(const aabb_t<T>& box0, const aabb_t<T>& box1) {
+        vec3_t<T> small{
+            std::min(box0.minimum.x, box1.minimum.x),
+            std::min(box0.minimum.y, box1.minimum.y),
+            std::min(box0.minimum.z, box1.minimum.z)
         };
 
-        vec3 big{
-            fmax(box0.maximum.x, box1.maximum.x),
-            fmax(box0.maximum.y, box1.maximum.y),
-            fmax(box0.maximum.z, box1.maximum.z)
+        vec3_t<T> big{
+            std::max(box0.maximum.x, box1.maximum.x),
+            std::max(box0.maximum.y, box1.maximum.y),
+            std::max(box0.maximum.z, box1.maximum.z)
         };
 
-        return aabb(small, big);
+        return aabb_t<T>(small, big);
     }
\ No newline at end of file
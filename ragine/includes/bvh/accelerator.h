@@ -0,0 +1,276 @@
+#pragma once
+
+#include "ragine.h"
+#include "../ray_tracing/object.h"
+#include "linear_bvh.h"
+#include "wide_bvh.h"
+#include "compressed_bvh.h"
+#include "motion_bvh.h"
+#include "grid_accel.h"
+#include "kd_tree.h"
+#include "scene.h"
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/// @brief 所有加速结构后端共用的构建参数，每个后端只读取自己的那一份
+struct accel_options {
+    bvh_build_options bvh;
+    grid_options grid;
+    kd_tree_options kd_tree;
+    int probe_rays = 4096;      // auto 模式下每个候选后端测试的光线数
+    int probe_repeats = 5;      // 每个候选后端重复探测的次数，取吞吐量的中位数
+    double probe_tolerance = 0.05;  // 中位数领先不超过该比例时视为持平，保留注册顺序靠前的后端
+};
+
+/// @brief 加速结构的构建结果统计
+struct accel_stats {
+    std::string backend;
+    double build_ms = 0.0;
+    bvh_stats structure;        // 节点数量、叶子数量与深度，线性列表为 0
+    bool cached = false;        // BVH 是否从缓存文件加载
+    /// auto 模式下每个候选后端的探测结果：名称、构建耗时 (毫秒) 与吞吐量中位数 (百万光线每秒)
+    std::vector<std::tuple<std::string, double, double>> probes;
+};
+
+/// @brief 加速结构后端：由物体列表构建一个 Hittable，并填写 stats.structure 与 stats.cached
+using accel_builder = std::function<std::shared_ptr<Hittable>(const std::vector<std::shared_ptr<Hittable>>& objects,
+    double time0, double time1, const accel_options& options, accel_stats& stats)>;
+
+/// @brief 加速结构后端注册表，内置 linear / bvh / obvh / compressed / motion_bvh / grid / kd_tree
+/// 其他后端调用 add 注册后即可按名称构建，也会参与 auto 模式的选择
+class accel_registry {
+public:
+    struct entry {
+        std::string name;
+        accel_builder builder;
+        size_t max_auto_objects;    // 物体数超过该值时 auto 模式不再尝试该后端，0 表示不限
+    };
+
+    static accel_registry& global() {
+        static accel_registry registry;
+        return registry;
+    }
+
+    /// @brief 注册后端，同名后端会被替换
+    void add(const std::string& name, accel_builder builder, size_t max_auto_objects = 0) {
+        for (entry& e : entries) {
+            if (e.name == name) {
+                e.builder = std::move(builder);
+                e.max_auto_objects = max_auto_objects;
+                return;
+            }
+        }
+        entries.push_back({name, std::move(builder), max_auto_objects});
+    }
+
+    const entry* find(const std::string& name) const {
+        for (const entry& e : entries) {
+            if (e.name == name) return &e;
+        }
+        return nullptr;
+    }
+
+    const std::vector<entry>& backends() const { return entries; }
+
+private:
+    accel_registry() {
+        // 线性测试只在物体很少时有竞争力，物体多时不必浪费探测时间
+        add("linear", [](const std::vector<std::shared_ptr<Hittable>>& objects, double, double, const accel_options&, accel_stats&) {
+            return std::make_shared<HittableList>(objects);
+        }, 256);
+        add("bvh", [](const std::vector<std::shared_ptr<Hittable>>& objects, double time0, double time1,
+            const accel_options& options, accel_stats& stats) {
+            auto scene = std::make_shared<Scene>(HittableList(objects), time0, time1, options.bvh);
+            stats.structure = scene->stats(options.bvh);
+            stats.cached = scene->bounded && scene->bounded->is_cached();
+            return scene;
+        });
+        add("obvh", [](const std::vector<std::shared_ptr<Hittable>>& objects, double time0, double time1,
+            const accel_options& options, accel_stats& stats) {
+            return with_unbounded<OBVH>(objects, [&](const HittableList& bounded) {
+                auto accel = std::make_shared<OBVH>(bounded, time0, time1, options.bvh);
+                stats.structure = accel->stats(options.bvh);
+                return accel;
+            }, time0, time1);
+        });
+        add("compressed", [](const std::vector<std::shared_ptr<Hittable>>& objects, double time0, double time1,
+            const accel_options& options, accel_stats& stats) {
+            return with_unbounded<CompressedBVH>(objects, [&](const HittableList& bounded) {
+                auto accel = std::make_shared<CompressedBVH>(bounded, time0, time1, options.bvh);
+                stats.structure = accel->stats(options.bvh);
+                return accel;
+            }, time0, time1);
+        });
+        add("motion_bvh", [](const std::vector<std::shared_ptr<Hittable>>& objects, double time0, double time1,
+            const accel_options& options, accel_stats& stats) {
+            return with_unbounded<MotionBVH>(objects, [&](const HittableList& bounded) {
+                auto accel = std::make_shared<MotionBVH>(bounded, time0, time1, options.bvh);
+                stats.structure = accel->stats(options.bvh);
+                return accel;
+            }, time0, time1);
+        });
+        add("grid", [](const std::vector<std::shared_ptr<Hittable>>& objects, double time0, double time1,
+            const accel_options& options, accel_stats& stats) {
+            auto accel = std::make_shared<GridAccel>(objects, time0, time1, options.grid);
+            stats.structure.node_count = accel->occupied_cells();
+            return accel;
+        });
+        add("kd_tree", [](const std::vector<std::shared_ptr<Hittable>>& objects, double time0, double time1,
+            const accel_options& options, accel_stats& stats) {
+            auto accel = std::make_shared<KdTree>(objects, time0, time1, options.kd_tree);
+            stats.structure = accel->stats();
+            return accel;
+        });
+    }
+
+    /// @brief 只能容纳有包围盒物体的后端：无限物体与构建结果放进同一个列表，先逐个测试无限物体
+    template <typename Accel, typename Build>
+    static std::shared_ptr<Hittable> with_unbounded(const std::vector<std::shared_ptr<Hittable>>& objects, Build&& build,
+        double time0, double time1) {
+        HittableList bounded, unbounded;
+        for (const auto& object : objects) {
+            aabb box;
+            if (object->bounding_box(time0, time1, box)) bounded.add(object);
+            else unbounded.add(object);
+        }
+
+        std::shared_ptr<Accel> accel = build(bounded);
+        if (unbounded.objects.empty()) return accel;
+        unbounded.add(accel);
+        return std::make_shared<HittableList>(unbounded);
+    }
+
+    std::vector<entry> entries;
+};
+
+/// @brief 统一的加速结构：按名称从注册表选择后端构建，is_hit / is_occluded 直接转发给后端
+/// 名称为 "auto" 时构建所有候选后端，用一小批随机光线重复测试吞吐量，保留中位数最快的一个
+class Accelerator : public Hittable {
+public:
+    std::shared_ptr<Hittable> backend;
+
+    Accelerator() {}
+
+    /// @brief 从 HittableList 构建加速结构
+    /// @param time0 快门开启时间
+    /// @param time1 快门关闭时间
+    /// @param name 后端名称，见 accel_registry；"auto" 表示自动选择
+    Accelerator(const HittableList& list, double time0, double time1, const std::string& name = "auto",
+        const accel_options& options = accel_options()) {
+        const accel_registry& registry = accel_registry::global();
+        const accel_registry::entry* chosen = name == "auto" ? nullptr : registry.find(name);
+        if (name != "auto" && !chosen) {
+            std::cerr << "WARNING: Unknown accelerator '" << name << "', selecting one automatically.\n";
+        }
+
+        if (chosen) {
+            backend = build(*chosen, list.objects, time0, time1, options, info);
+        } else {
+            select(registry, list.objects, time0, time1, options);
+        }
+    }
+
+    virtual bool is_hit(const ray& r, hit& record, double t_min, double t_max) const override {
+        return backend && backend->is_hit(r, record, t_min, t_max);
+    }
+
+    virtual bool intersect(const ray& r, double t_min, double t_max, hit_candidate& candidate) const override {
+        return backend && backend->intersect(r, t_min, t_max, candidate);
+    }
+
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        return backend && backend->is_occluded(r, t_min, t_max);
+    }
+
+    virtual bool bounding_box(double t0, double t1, aabb& output_box) const override {
+        return backend && backend->bounding_box(t0, t1, output_box);
+    }
+
+    virtual vec3 get_position() const override {
+        return {0.0, 0.0, 0.0};
+    }
+
+    const accel_stats& stats() const { return info; }
+
+private:
+    accel_stats info;
+
+    static std::shared_ptr<Hittable> build(const accel_registry::entry& entry, const std::vector<std::shared_ptr<Hittable>>& objects,
+        double time0, double time1, const accel_options& options, accel_stats& stats) {
+        stats.backend = entry.name;
+        auto start_time = std::chrono::high_resolution_clock::now();
+        std::shared_ptr<Hittable> result = entry.builder(objects, time0, time1, options, stats);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start_time;
+        stats.build_ms = elapsed.count();
+        return result;
+    }
+
+    /// @brief 探测光线：起点均匀分布在有限物体的包围盒内，方向与时刻 (快门区间内) 随机，固定种子保证每次选择一致
+    static std::vector<ray> probe_rays(const std::vector<std::shared_ptr<Hittable>>& objects, double time0, double time1, int count) {
+        aabb bounds = empty_box();
+        for (const auto& object : objects) {
+            aabb box;
+            if (object->bounding_box(time0, time1, box)) bounds = surrounding_box(bounds, box);
+        }
+        if (bounds.minimum.x > bounds.maximum.x) bounds = aabb(vec3{-1, -1, -1}, vec3{1, 1, 1});
+
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::vector<ray> rays(count);
+        for (ray& r : rays) {
+            vec3 origin;
+            for (int axis = 0; axis < 3; axis++) {
+                origin[axis] = bounds.minimum[axis] + uniform(rng) * (bounds.maximum[axis] - bounds.minimum[axis]);
+            }
+            r = ray{origin, vec3{uniform(rng) * 2 - 1, uniform(rng) * 2 - 1, uniform(rng) * 2 - 1}};
+            r.time = time0 + uniform(rng) * (time1 - time0);
+        }
+        return rays;
+    }
+
+    void select(const accel_registry& registry, const std::vector<std::shared_ptr<Hittable>>& objects,
+        double time0, double time1, const accel_options& options) {
+        auto select_start = std::chrono::high_resolution_clock::now();
+        std::vector<ray> rays = probe_rays(objects, time0, time1, options.probe_rays);
+        std::vector<std::tuple<std::string, double, double>> probes;
+        double best_mrays = -1.0;
+
+        for (const accel_registry::entry& entry : registry.backends()) {
+            if (entry.max_auto_objects > 0 && objects.size() > entry.max_auto_objects) continue;
+
+            accel_stats candidate_stats;
+            std::shared_ptr<Hittable> candidate = build(entry, objects, time0, time1, options, candidate_stats);
+
+            // 单次计时容易受其他进程干扰，取多次探测的中位数
+            std::vector<double> samples(std::max(1, options.probe_repeats));
+            for (double& sample : samples) {
+                auto start_time = std::chrono::high_resolution_clock::now();
+                for (const ray& r : rays) {
+                    hit record;
+                    candidate->is_hit(r, record, MINIMUM, INFINITY);
+                }
+                std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start_time;
+                sample = rays.size() / std::max(elapsed.count(), 1e-9) / 1e6;
+            }
+            std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+            double mrays = samples[samples.size() / 2];
+            probes.push_back({entry.name, candidate_stats.build_ms, mrays});
+
+            // 只有明显更快时才替换，差距在噪声范围内的后端按注册顺序取靠前的一个，选择结果不随计时抖动变化
+            if (best_mrays < 0.0 || mrays > best_mrays * (1.0 + options.probe_tolerance)) {
+                best_mrays = mrays;
+                backend = candidate;
+                info = candidate_stats;
+            }
+        }
+
+        // auto 模式的构建耗时包含所有候选后端的构建与探测
+        std::chrono::duration<double, std::milli> select_ms = std::chrono::high_resolution_clock::now() - select_start;
+        info.build_ms = select_ms.count();
+        info.probes = std::move(probes);
+    }
+};
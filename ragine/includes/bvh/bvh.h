@@ -2,66 +2,81 @@
 
 #include "ragine.h"
 #include "../ray_tracing/object.h"
+#include "bvh_build.h"
 
+/// @brief 以 shared_ptr 连接的 BVH 节点
+/// 内部节点只有左右子节点；叶子节点没有子节点，primitives 中保存一段连续的物体 (数量不超过 max_leaf_size)
 class bvh_node : public Hittable {
 public:
     aabb box;
-    std::shared_ptr<Hittable> left_child;
-    std::shared_ptr<Hittable> right_child;
+    std::shared_ptr<bvh_node> left_child;
+    std::shared_ptr<bvh_node> right_child;
+    std::vector<std::shared_ptr<Hittable>> primitives;
+    double build_sah_cost = 0.0;    // 构建完成时的 SAH 代价 (只在根节点上记录)，refit 时用于衡量树质量
 
     bvh_node() {}
 
+    /// @brief 以分桶 SAH 构建 objects[start, end) 的 BVH，结果与运行次数无关
+    /// @param time0 快门开启时间
+    /// @param time1 快门关闭时间
+    /// @param options 构建参数 (叶子大小、分桶数量、代价系数、并行阈值)
     bvh_node(const std::vector<std::shared_ptr<Hittable>>& src_objects, const size_t start, const size_t end, 
-        double time0, double time1) {
-        auto objects = src_objects;
-        int axis = (int)random_double(0, 3);
-
-        // 提供自定义排序函数，该函数为一个 bool 返回值的匿名函数，传入两个变量
-        // 如果返回值为 true，则第一个变量排在第二个变量之前
-        // 如果返回值为 false，则第一个变量排在第二个变量之后
-        auto comparator = [axis](const std::shared_ptr<Hittable>& a, const std::shared_ptr<Hittable>& b) {
-            aabb box_a, box_b;
-            if (!a->bounding_box(0, 0, box_a) || !b->bounding_box(0, 0, box_b)) 
-                std::cerr << "No enough bounding box in bvh_node constructor" << std::endl;
-            return box_a.minimum[axis] < box_b.minimum[axis];
-        };
-        
-        size_t object_count = end - start;
-        if (object_count == 1) {
-            left_child = right_child = objects[start];
-        } else if (object_count == 2) {
-            if (comparator(objects[start], objects[start + 1])){
-                left_child = objects[start];
-                right_child = objects[start + 1];
-            } else {
-                left_child = objects[start + 1];
-                right_child = objects[start];
-            }
-        } else {
-            std::sort(objects.begin() + start, objects.begin() + end, comparator);
-            size_t mid = start + object_count / 2;
-            left_child = std::make_shared<bvh_node>(objects, start, mid, time0, time1);
-            right_child = std::make_shared<bvh_node>(objects, mid, end, time0, time1);
-        }
-
-        aabb box_left, box_right;
-        if (!left_child->bounding_box(0, 0, box_left) || !right_child->bounding_box(0, 0, box_right))
-            std::cerr << "No enough bounding box in bvh_node constructor" << std::endl;
-        box = surrounding_box(box_left, box_right);
+        double time0, double time1, const bvh_build_options& options = bvh_build_options()) {
+        bvh_build_tree tree = build_bvh(src_objects, start, end, time0, time1, options);
+        if (!tree.empty()) build(src_objects, tree, 0);
+        build_sah_cost = stats(options).sah_cost;
     }
 
-    bvh_node(const HittableList& list, double time0, double time1)
-        : bvh_node(list.objects, 0, list.objects.size(), time0, time1) {}
+    bvh_node(const HittableList& list, double time0, double time1, const bvh_build_options& options = bvh_build_options())
+        : bvh_node(list.objects, 0, list.objects.size(), time0, time1, options) {}
+
+    /// @brief 由构建树 tree 中下标为 index 的节点生成子树
+    bvh_node(const std::vector<std::shared_ptr<Hittable>>& objects, const bvh_build_tree& tree, uint32_t index) {
+        build(objects, tree, index);
+    }
 
     virtual bool is_hit(const ray& r, hit& record, double t_min, double t_max) const override {
+        return deferred_hit(r, record, t_min, t_max);
+    }
+
+    virtual bool intersect(const ray& r, double t_min, double t_max, hit_candidate& candidate) const override {
+        RAGINE_BVH_COUNT(node_visits, 1);
         if (!box.is_hit(r, t_min, t_max)) return false;
 
-        bool hit_left = left_child->is_hit(r, record, t_min, t_max);
-        bool hit_right = right_child->is_hit(r, record, t_min, hit_left ? record.time : t_max);
+        if (!left_child) {
+            bool hit_anything = false;
+            double closest_so_far = t_max;
+            RAGINE_BVH_COUNT(primitive_tests, primitives.size());
+            for (const auto& object : primitives) {
+                if (object->intersect(r, t_min, closest_so_far, candidate)) {
+                    hit_anything = true;
+                    closest_so_far = candidate.time;
+                }
+            }
+            return hit_anything;
+        }
+
+        bool hit_left = left_child->intersect(r, t_min, t_max, candidate);
+        bool hit_right = right_child->intersect(r, t_min, hit_left ? candidate.time : t_max, candidate);
 
         return hit_left || hit_right;
     }
 
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        RAGINE_BVH_COUNT(node_visits, 1);
+        if (!box.is_hit(r, t_min, t_max)) return false;
+
+        if (!left_child) {
+            for (const auto& object : primitives) {
+                RAGINE_BVH_COUNT(primitive_tests, 1);
+                if (object->is_occluded(r, t_min, t_max)) return true;
+            }
+            return false;
+        }
+
+        return left_child->is_occluded(r, t_min, t_max) || right_child->is_occluded(r, t_min, t_max);
+    }
+
     virtual bool bounding_box(double t0, double t1, aabb& output_box) const override {
         output_box = box;
         return true;
@@ -70,4 +85,77 @@ public:
     virtual vec3 get_position() const override {
         return {0.0, 0.0, 0.0}; 
     }
-};
\ No newline at end of file
+
+    /// @brief 统计节点数量、深度与期望遍历代价 (SAH cost)
+    bvh_stats stats(const bvh_build_options& options = bvh_build_options()) const {
+        bvh_stats result;
+        collect_stats(result, box.surface_area(), 1, options);
+        return result;
+    }
+
+    /// @brief 物体移动或缩放后，不改变树结构，自底向上重新计算所有节点的包围盒 (上层子树并行处理)
+    /// @param time0 快门开启时间
+    /// @param time1 快门关闭时间
+    /// @return 重新拟合后的 SAH 代价与构建时的比值，明显大于 1 (比如超过 1.5) 说明树的质量已经下降，值得完全重建
+    double refit(double time0 = 0.0, double time1 = 0.0) {
+        if (!left_child && primitives.empty()) return 1.0;
+
+        #pragma omp parallel
+        {
+            #pragma omp single
+            refit_subtree(time0, time1, 0);
+        }
+        return build_sah_cost > 0.0 ? stats().sah_cost / build_sah_cost : 1.0;
+    }
+
+private:
+    void refit_subtree(double time0, double time1, int depth) {
+        if (!left_child) {
+            box = empty_box();
+            for (const auto& object : primitives) {
+                aabb object_box;
+                object->bounding_box(time0, time1, object_box);
+                box = surrounding_box(box, object_box);
+            }
+            return;
+        }
+
+        // 只把上面几层的子树作为并行任务，避免任务数量过多
+        #pragma omp task if (depth < 6)
+        left_child->refit_subtree(time0, time1, depth + 1);
+        right_child->refit_subtree(time0, time1, depth + 1);
+        #pragma omp taskwait
+
+        box = surrounding_box(left_child->box, right_child->box);
+    }
+
+    void build(const std::vector<std::shared_ptr<Hittable>>& objects, const bvh_build_tree& tree, uint32_t index) {
+        const bvh_build_node& node = tree.nodes[index];
+
+        if (node.count > 0) {
+            primitives.reserve(node.count);
+            for (size_t i = node.first; i < node.first + node.count; i++) primitives.push_back(objects[tree.prims[i].index]);
+            box = primitive_bounds(tree.prims, node.first, node.first + node.count);
+        } else {
+            left_child = std::make_shared<bvh_node>(objects, tree, node.child[0]);
+            right_child = std::make_shared<bvh_node>(objects, tree, node.child[1]);
+            box = surrounding_box(left_child->box, right_child->box);
+        }
+    }
+
+    void collect_stats(bvh_stats& result, double root_area, size_t depth, const bvh_build_options& options) const {
+        double weight = root_area > 0.0 ? box.surface_area() / root_area : 1.0;
+        result.node_count++;
+        result.max_depth = std::max(result.max_depth, depth);
+        result.sah_cost += options.traversal_cost * weight;
+
+        if (!left_child) {
+            result.leaf_count++;
+            result.sah_cost += options.intersect_cost * weight * primitives.size();
+            return;
+        }
+
+        left_child->collect_stats(result, root_area, depth + 1, options);
+        right_child->collect_stats(result, root_area, depth + 1, options);
+    }
+};
@@ -0,0 +1,729 @@
+#pragma once
+
+#include "ragine.h"
+#include "../ray_tracing/object.h"
+#include "morton.h"
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <string>
+
+/// @brief BVH 构建算法
+enum class bvh_build_method {
+    sah,    // 自顶向下分桶 SAH，质量最好
+    lbvh,   // Morton 码排序后按位划分，构建最快，适合每帧重建
+    hlbvh   // 底层按 Morton 码划分，顶层 morton_cluster_bits 位形成的簇之间再做 SAH
+};
+
+/// @brief 扁平化 BVH 的节点排列顺序，兄弟节点总是相邻
+enum class bvh_layout {
+    depth_first,    // 深度优先，遍历时的下一个节点通常就在附近
+    breadth_first,  // 广度优先，上层节点集中在数组开头
+    van_emde_boas   // 递归地按子树聚集，与缓存大小无关地减少跨缓存行的访问
+};
+
+/// @brief BVH 构建参数
+struct bvh_build_options {
+    int max_leaf_size = 4;          // 叶子节点最多容纳的物体数量 (SAH 认为划分更划算时仍会继续划分)
+    int bin_count = 16;             // SAH 分桶数量
+    double traversal_cost = 1.0;    // 遍历一个节点 (一次包围盒测试) 的代价
+    double intersect_cost = 1.0;    // 与一个物体求交的代价
+    size_t parallel_threshold = 4096;   // 物体数量超过该值的子树作为并行任务构建
+    bvh_build_method method = bvh_build_method::sah;
+    int morton_cluster_bits = 12;   // hlbvh 顶层簇使用的 Morton 码高位数量 (每 3 位对应每轴 2 等分)
+    bvh_layout layout = bvh_layout::depth_first;   // LinearBVH 的节点排列顺序
+    int treelet_passes = 0;         // 构建完成后做几遍树片 (treelet) 重构，0 表示不做；lbvh 之后做 2~3 遍可接近 sah 的质量
+    std::string cache_directory;    // 非空时 LinearBVH 先在该目录查找与场景对应的缓存文件，未命中则构建后写入
+};
+
+/// @brief 构建时使用的物体引用：预先算好包围盒与中心点，避免在划分时反复调用虚函数
+struct bvh_primitive {
+    aabb box;
+    vec3 centroid;
+    size_t index;
+};
+
+/// @brief 最低位的 1 所在的位置 (mask 不能为 0)
+inline int lowest_bit(uint32_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(mask);
+#else
+    int i = 0;
+    while (!(mask & 1u)) { mask >>= 1; i++; }
+    return i;
+#endif
+}
+
+/// @brief BVH 的结构统计，sah_cost 为一条击中根节点的光线的期望遍历代价
+struct bvh_stats {
+    size_t node_count = 0;
+    size_t leaf_count = 0;
+    size_t max_depth = 0;
+    double sah_cost = 0.0;
+};
+
+/// @brief 遍历统计：bvh_traversal_stats_enabled 为 true 时，各 BVH 的求交会累计访问的节点数与物体求交次数
+/// 计数器按线程独立；开关是运行时变量而不是宏，所有翻译单元里遍历函数的定义都相同，关闭时只多一次可预测的分支
+struct bvh_traversal_stats {
+    size_t node_visits = 0;
+    size_t primitive_tests = 0;
+};
+
+inline bool bvh_traversal_stats_enabled = false;
+inline thread_local bvh_traversal_stats bvh_traversal_counters;
+
+#define RAGINE_BVH_COUNT(field, n) \
+    (bvh_traversal_stats_enabled ? (void)(bvh_traversal_counters.field += (n)) : (void)0)
+
+/// @brief 二叉 BVH 的最大深度 (根到最深叶子的边数)，各 BVH 遍历时栈上数组的容量由它决定
+/// 构建时剩余深度不够时改为按数量对半划分，任何输入 (比如大量重合的物体) 都不会超过该深度
+constexpr int bvh_max_depth = 64;
+
+/// @brief 不小于 log2(count) 的最小整数，count 个物体按数量对半划分时需要的层数
+inline int ceil_log2(size_t count) {
+    int bits = 0;
+    while (bits < 64 && ((size_t)1 << bits) < count) bits++;
+    return bits;
+}
+
+/// @brief 在 depth 处的 count 个物体是否只能按数量对半划分，才能保证整棵子树不超过 depth_limit
+inline bool bvh_depth_exhausted(int depth, size_t count, int depth_limit = bvh_max_depth) {
+    return depth + ceil_log2(count) >= depth_limit;
+}
+
+/// @brief 为 objects[start, end) 生成构建用的物体引用 (物体较多时并行计算包围盒)
+inline std::vector<bvh_primitive> make_bvh_primitives(const std::vector<std::shared_ptr<Hittable>>& objects,
+    size_t start, size_t end, double time0, double time1,
+    size_t parallel_threshold = bvh_build_options().parallel_threshold) {
+    std::vector<bvh_primitive> prims(end - start);
+    long long count = (long long)(end - start);
+
+    #pragma omp parallel for schedule(static) if (end - start >= parallel_threshold)
+    for (long long i = 0; i < count; i++) {
+        aabb box;
+        if (!objects[start + i]->bounding_box(time0, time1, box))
+            std::cerr << "No enough bounding box in bvh_node constructor" << std::endl;
+        prims[i] = {box, box.centroid(), start + (size_t)i};
+    }
+
+    return prims;
+}
+
+inline aabb primitive_bounds(const std::vector<bvh_primitive>& prims, size_t start, size_t end) {
+    aabb bounds = empty_box();
+    for (size_t i = start; i < end; i++) bounds = surrounding_box(bounds, prims[i].box);
+    return bounds;
+}
+
+/// @brief SAH 分桶数量上限，分桶数组放在栈上，划分时不做堆分配
+constexpr int bvh_max_bins = 32;
+
+/// @brief SAH 分桶，只含基本类型，放在栈上时不需要初始化整块数组
+struct bvh_bin {
+    double lo[3], hi[3];
+    size_t count;
+
+    void clear() {
+        for (int axis = 0; axis < 3; axis++) {
+            lo[axis] = INFINITY;
+            hi[axis] = -INFINITY;
+        }
+        count = 0;
+    }
+
+    void add(const aabb& box) {
+        for (int axis = 0; axis < 3; axis++) {
+            lo[axis] = std::min(lo[axis], box.minimum[axis]);
+            hi[axis] = std::max(hi[axis], box.maximum[axis]);
+        }
+        count++;
+    }
+
+    void merge(const bvh_bin& other) {
+        for (int axis = 0; axis < 3; axis++) {
+            lo[axis] = std::min(lo[axis], other.lo[axis]);
+            hi[axis] = std::max(hi[axis], other.hi[axis]);
+        }
+        count += other.count;
+    }
+
+    double surface_area() const {
+        if (count == 0) return 0.0;
+        double dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+        return 2.0 * (dx * dy + dy * dz + dz * dx);
+    }
+};
+
+/// @brief 沿中心点跨度最大的轴按数量对半划分 [start, end)，两侧物体数相差不超过 1
+inline void median_partition(std::vector<bvh_primitive>& prims, size_t start, size_t end, size_t& mid, int& split_axis) {
+    aabb centroid_bounds = empty_box();
+    for (size_t i = start; i < end; i++) centroid_bounds = surrounding_box(centroid_bounds, prims[i].centroid);
+
+    int axis = centroid_bounds.longest_axis();
+    split_axis = axis;
+    mid = start + (end - start) / 2;
+    std::nth_element(prims.begin() + start, prims.begin() + mid, prims.begin() + end,
+        [axis](const bvh_primitive& a, const bvh_primitive& b) {
+            return a.centroid[axis] < b.centroid[axis];
+        });
+}
+
+/// @brief 分桶 SAH 划分：在三个轴上各取 bin_count 个桶，选期望代价最小的轴与划分位置，并原地划分 prims
+/// @param prims 物体引用数组，[start, end) 区间会被重新排列
+/// @param bounds [start, end) 内所有物体的包围盒
+/// @param mid 输出划分位置，[start, mid) 为左子树，[mid, end) 为右子树
+/// @param split_axis 输出划分轴
+/// @return 如果直接作为叶子节点更划算 (且物体数量不超过 max_leaf_size) 返回 false
+inline bool sah_partition(std::vector<bvh_primitive>& prims, size_t start, size_t end, const aabb& bounds,
+    const bvh_build_options& options, size_t& mid, int& split_axis) {
+    size_t count = end - start;
+    // 物体很少时桶数不超过物体数量，避免小节点上大量空桶的开销
+    int bin_count = (int)std::min<size_t>(std::min(bvh_max_bins, std::max(2, options.bin_count)), std::max<size_t>(2, count));
+
+    aabb centroid_bounds = empty_box();
+    for (size_t i = start; i < end; i++) centroid_bounds = surrounding_box(centroid_bounds, prims[i].centroid);
+
+    bvh_bin bins[3][bvh_max_bins];
+    double lo[3], scale[3];
+
+    for (int axis = 0; axis < 3; axis++) {
+        lo[axis] = centroid_bounds.minimum[axis];
+        double extent = centroid_bounds.maximum[axis] - lo[axis];
+        scale[axis] = extent > 0.0 ? bin_count / extent : 0.0;
+        for (int b = 0; b < bin_count; b++) bins[axis][b].clear();
+    }
+
+    // 一次遍历同时为三个轴分桶
+    for (size_t i = start; i < end; i++) {
+        for (int axis = 0; axis < 3; axis++) {
+            int b = std::min(bin_count - 1, (int)((prims[i].centroid[axis] - lo[axis]) * scale[axis]));
+            bins[axis][b].add(prims[i].box);
+        }
+    }
+
+    int best_axis = -1;
+    int best_bin = 0;
+    double best_cost = INFINITY;
+    double right_area[bvh_max_bins];
+    size_t right_count[bvh_max_bins];
+
+    for (int axis = 0; axis < 3; axis++) {
+        if (scale[axis] <= 0.0) continue;
+
+        // 从右向左累加，right_area[b] 与 right_count[b] 表示桶 [b, bin_count) 的合并结果
+        bvh_bin acc;
+        acc.clear();
+        for (int b = bin_count - 1; b > 0; b--) {
+            acc.merge(bins[axis][b]);
+            right_area[b] = acc.surface_area();
+            right_count[b] = acc.count;
+        }
+
+        // 从左向右扫描，划分位置 b 表示桶 [0, b) 进入左子树
+        acc.clear();
+        for (int b = 1; b < bin_count; b++) {
+            acc.merge(bins[axis][b - 1]);
+            if (acc.count == 0 || right_count[b] == 0) continue;
+
+            double cost = acc.surface_area() * acc.count + right_area[b] * right_count[b];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = b;
+            }
+        }
+    }
+
+    double parent_area = bounds.surface_area();
+    double leaf_cost = options.intersect_cost * count;
+    if (best_axis >= 0 && parent_area > 0.0) {
+        best_cost = options.traversal_cost + options.intersect_cost * best_cost / parent_area;
+    }
+
+    if (count <= (size_t)std::max(1, options.max_leaf_size) && (best_axis < 0 || leaf_cost <= best_cost)) {
+        return false;
+    }
+
+    if (best_axis >= 0) {
+        double axis_lo = lo[best_axis];
+        double axis_scale = scale[best_axis];
+        auto it = std::partition(prims.begin() + start, prims.begin() + end,
+            [=](const bvh_primitive& p) {
+                int b = std::min(bin_count - 1, (int)((p.centroid[best_axis] - axis_lo) * axis_scale));
+                return b < best_bin;
+            });
+        mid = it - prims.begin();
+        split_axis = best_axis;
+        if (mid != start && mid != end) return true;
+    }
+
+    // 所有中心点重合 (或划分退化)：按数量对半划分，保证递归能够结束
+    median_partition(prims, start, end, mid, split_axis);
+    return true;
+}
+
+/// @brief 构建阶段的二叉树节点 (16 字节)，包围盒在转换成最终布局时再自底向上计算
+struct bvh_build_node {
+    uint32_t child[2];  // 内部节点的左右子节点下标
+    uint32_t first;     // 叶子节点: 第一个物体在 prims 中的下标
+    uint16_t count;     // 叶子节点的物体数量，0 表示内部节点
+    uint8_t axis;       // 内部节点的划分轴
+    uint8_t pad;
+};
+
+/// @brief 与具体内存布局无关的构建结果，bvh_node / LinearBVH 等结构都由它转换而来
+/// 叶子节点引用 prims 中的连续区间
+struct bvh_build_tree {
+    std::vector<bvh_build_node> nodes;  // nodes[0] 为根节点
+    std::vector<bvh_primitive> prims;
+
+    bool empty() const { return nodes.empty(); }
+};
+
+/// @param depth tree.nodes[index] 的深度，接近 bvh_max_depth 时不再做 SAH 划分
+inline void build_bvh_subtree(bvh_build_tree& tree, std::atomic<uint32_t>& next_node, uint32_t index,
+    size_t start, size_t end, const aabb& bounds, int depth, const bvh_build_options& options) {
+    size_t mid = start;
+    int axis = 0;
+    bvh_build_node& node = tree.nodes[index];
+    size_t count = end - start;
+
+    bool split;
+    if (count == 1) {
+        split = false;
+    } else if (bvh_depth_exhausted(depth, count)) {
+        // SAH 在退化输入上可能每次只分出一个物体，深度随物体数线性增长
+        split = count > (size_t)std::max(1, options.max_leaf_size);
+        if (split) median_partition(tree.prims, start, end, mid, axis);
+    } else {
+        split = sah_partition(tree.prims, start, end, bounds, options, mid, axis);
+    }
+
+    if (!split) {
+        node.first = (uint32_t)start;
+        node.count = (uint16_t)count;
+        return;
+    }
+
+    // 两个子节点一次性从预先分配好的节点数组中取出，构建过程中不再分配内存
+    uint32_t left = next_node.fetch_add(2);
+    node.child[0] = left;
+    node.child[1] = left + 1;
+    node.count = 0;
+    node.axis = (uint8_t)axis;
+
+    aabb left_bounds = primitive_bounds(tree.prims, start, mid);
+    aabb right_bounds = primitive_bounds(tree.prims, mid, end);
+
+    if (end - start >= options.parallel_threshold) {
+        #pragma omp task default(shared) firstprivate(left, start, mid, left_bounds, depth)
+        build_bvh_subtree(tree, next_node, left, start, mid, left_bounds, depth + 1, options);
+
+        build_bvh_subtree(tree, next_node, left + 1, mid, end, right_bounds, depth + 1, options);
+
+        #pragma omp taskwait
+    } else {
+        build_bvh_subtree(tree, next_node, left, start, mid, left_bounds, depth + 1, options);
+        build_bvh_subtree(tree, next_node, left + 1, mid, end, right_bounds, depth + 1, options);
+    }
+}
+
+/// @brief 在物体引用数组上原地划分并构建二叉 BVH，物体数量超过 parallel_threshold 的子树作为 OpenMP 任务并行构建
+inline bvh_build_tree build_bvh_sah(std::vector<bvh_primitive> prims, const bvh_build_options& options) {
+    bvh_build_tree tree;
+    tree.prims = std::move(prims);
+    if (tree.prims.empty()) return tree;
+
+    // 每个叶子至少一个物体，节点总数不超过 2n - 1
+    size_t count = tree.prims.size();
+    tree.nodes.resize(2 * count - 1);
+    std::atomic<uint32_t> next_node{1};
+    aabb bounds = primitive_bounds(tree.prims, 0, count);
+
+    #pragma omp parallel if (count >= options.parallel_threshold)
+    {
+        #pragma omp single
+        build_bvh_subtree(tree, next_node, 0, 0, count, bounds, 0, options);
+    }
+
+    tree.nodes.resize(next_node.load());
+    tree.nodes.shrink_to_fit();
+    return tree;
+}
+
+/// @brief 按已排序的 Morton 码自顶向下划分：在第一个取值不同的位上二分，叶子不超过 max_leaf_size 个物体
+/// 每一位只分出一个物体时深度可达 63 + log2(n)，接近 bvh_max_depth 后改为按数量对半划分
+/// @param bit 当前检查的最高位，[start, end) 内所有 Morton 码在更高的位上相同
+/// @param depth tree.nodes[index] 的深度
+inline void emit_lbvh(bvh_build_tree& tree, std::atomic<uint32_t>& next_node, const std::vector<morton_primitive>& codes,
+    uint32_t index, size_t start, size_t end, int bit, int depth, const bvh_build_options& options) {
+    bvh_build_node& node = tree.nodes[index];
+    size_t count = end - start;
+    size_t max_leaf = (size_t)std::max(1, options.max_leaf_size);
+
+    // 已排序，区间首尾在某一位上相同说明整个区间在该位上相同
+    while (bit >= 0 && ((codes[start].code >> bit) & 1) == ((codes[end - 1].code >> bit) & 1)) bit--;
+
+    if (count <= max_leaf) {
+        node.first = (uint32_t)start;
+        node.count = (uint16_t)count;
+        return;
+    }
+
+    size_t mid;
+    int child_bit = bit;
+    if (bit < 0 || bvh_depth_exhausted(depth, count)) {
+        // Morton 码完全相同或剩余深度不足，按数量对半划分；区间仍按 Morton 码有序，子区间从同一位继续检查
+        mid = start + count / 2;
+        node.axis = (uint8_t)(bit < 0 ? 0 : morton_bit_axis(bit));
+    } else {
+        uint64_t probe = (codes[start].code >> bit | 1) << bit;
+        mid = std::lower_bound(codes.begin() + start, codes.begin() + end, probe,
+            [](const morton_primitive& p, uint64_t value) { return p.code < value; }) - codes.begin();
+        node.axis = (uint8_t)morton_bit_axis(bit);
+        child_bit = bit - 1;
+    }
+
+    uint32_t left = next_node.fetch_add(2);
+    node.child[0] = left;
+    node.child[1] = left + 1;
+    node.count = 0;
+
+    if (count >= options.parallel_threshold) {
+        #pragma omp task default(shared) firstprivate(left, start, mid, child_bit, depth)
+        emit_lbvh(tree, next_node, codes, left, start, mid, child_bit, depth + 1, options);
+
+        emit_lbvh(tree, next_node, codes, left + 1, mid, end, child_bit, depth + 1, options);
+
+        #pragma omp taskwait
+    } else {
+        emit_lbvh(tree, next_node, codes, left, start, mid, child_bit, depth + 1, options);
+        emit_lbvh(tree, next_node, codes, left + 1, mid, end, child_bit, depth + 1, options);
+    }
+}
+
+/// @brief hlbvh 顶层的深度上限：顶层与各簇的子树各占一半的 bvh_max_depth
+constexpr int hlbvh_top_depth = bvh_max_depth / 2;
+
+/// @brief hlbvh 顶层：在各个簇之间做 SAH 划分，只有一个簇时直接接上该簇的子树
+/// @param depth tree.nodes[index] 的深度，不超过 hlbvh_top_depth
+inline void emit_cluster_sah(bvh_build_tree& tree, std::atomic<uint32_t>& next_node, std::vector<bvh_primitive>& clusters,
+    const std::vector<uint32_t>& cluster_roots, uint32_t index, size_t start, size_t end, int depth, const bvh_build_options& options) {
+    if (end - start == 1) {
+        tree.nodes[index] = tree.nodes[cluster_roots[clusters[start].index]];
+        return;
+    }
+
+    bvh_build_options top_options = options;
+    top_options.max_leaf_size = 1;
+
+    size_t mid = start;
+    int axis = 0;
+    if (bvh_depth_exhausted(depth, end - start, hlbvh_top_depth)) {
+        median_partition(clusters, start, end, mid, axis);
+    } else {
+        sah_partition(clusters, start, end, primitive_bounds(clusters, start, end), top_options, mid, axis);
+    }
+
+    uint32_t left = next_node.fetch_add(2);
+    bvh_build_node& node = tree.nodes[index];
+    node.child[0] = left;
+    node.child[1] = left + 1;
+    node.count = 0;
+    node.axis = (uint8_t)axis;
+
+    emit_cluster_sah(tree, next_node, clusters, cluster_roots, left, start, mid, depth + 1, options);
+    emit_cluster_sah(tree, next_node, clusters, cluster_roots, left + 1, mid, end, depth + 1, options);
+}
+
+/// @brief Morton 码构建 (lbvh / hlbvh)：计算中心点的 Morton 码并行基数排序，再由排序结果直接生成层次结构
+inline bvh_build_tree build_bvh_morton(std::vector<bvh_primitive> prims, const bvh_build_options& options) {
+    bvh_build_tree tree;
+    size_t count = prims.size();
+    if (count == 0) return tree;
+
+    aabb centroid_bounds = empty_box();
+    for (const auto& p : prims) centroid_bounds = surrounding_box(centroid_bounds, p.centroid);
+    vec3 extent = centroid_bounds.maximum - centroid_bounds.minimum;
+    vec3 inv_extent{
+        extent.x > 0.0 ? 1.0 / extent.x : 0.0,
+        extent.y > 0.0 ? 1.0 / extent.y : 0.0,
+        extent.z > 0.0 ? 1.0 / extent.z : 0.0
+    };
+
+    std::vector<morton_primitive> codes(count);
+    long long n = (long long)count;
+    #pragma omp parallel for schedule(static) if (count >= options.parallel_threshold)
+    for (long long i = 0; i < n; i++) {
+        codes[i] = {morton_code((prims[i].centroid - centroid_bounds.minimum) * inv_extent), (uint32_t)i};
+    }
+
+    radix_sort_morton(codes, options.parallel_threshold);
+
+    // 物体引用按 Morton 顺序重新排列，叶子区间即为排序后的连续区间
+    tree.prims.resize(count);
+    #pragma omp parallel for schedule(static) if (count >= options.parallel_threshold)
+    for (long long i = 0; i < n; i++) tree.prims[i] = prims[codes[i].index];
+
+    int cluster_bits = options.method == bvh_build_method::hlbvh ? std::min(std::max(options.morton_cluster_bits, 0), 62) : 0;
+
+    // 按 Morton 码高 cluster_bits 位划分簇 (lbvh 时整个场景是一个簇)
+    std::vector<size_t> cluster_starts;
+    int cluster_shift = 63 - cluster_bits;
+    for (size_t i = 0; i < count; i++) {
+        if (i == 0 || (codes[i].code >> cluster_shift) != (codes[i - 1].code >> cluster_shift)) cluster_starts.push_back(i);
+    }
+    cluster_starts.push_back(count);
+    size_t cluster_count = cluster_starts.size() - 1;
+
+    // 每个叶子至少一个物体，节点总数不超过 2n - 1；每个簇的根在顶层复制一次，额外预留 cluster_count 个
+    tree.nodes.resize(2 * count - 1 + cluster_count);
+    std::atomic<uint32_t> next_node{1};
+
+    if (cluster_count == 1) {
+        #pragma omp parallel if (count >= options.parallel_threshold)
+        {
+            #pragma omp single
+            emit_lbvh(tree, next_node, codes, 0, 0, count, 62, 0, options);
+        }
+    } else {
+        std::vector<uint32_t> cluster_roots(cluster_count);
+        std::vector<bvh_primitive> clusters(cluster_count);
+        for (size_t c = 0; c < cluster_count; c++) cluster_roots[c] = next_node.fetch_add(1);
+
+        long long clusters_n = (long long)cluster_count;
+        #pragma omp parallel for schedule(dynamic) if (count >= options.parallel_threshold)
+        for (long long c = 0; c < clusters_n; c++) {
+            size_t start = cluster_starts[c], end = cluster_starts[c + 1];
+            // 簇的根最终位于顶层的叶子处，深度不超过 hlbvh_top_depth
+            emit_lbvh(tree, next_node, codes, cluster_roots[c], start, end, cluster_shift - 1, hlbvh_top_depth, options);
+            aabb box = primitive_bounds(tree.prims, start, end);
+            clusters[c] = {box, box.centroid(), (size_t)c};
+        }
+
+        emit_cluster_sah(tree, next_node, clusters, cluster_roots, 0, 0, cluster_count, 0, options);
+    }
+
+    tree.nodes.resize(next_node.load());
+    tree.nodes.shrink_to_fit();
+    return tree;
+}
+
+/// @brief 树片重构时每个节点的包围盒、SAH 代价 (未除以根节点面积)、子树中的物体数量与子树高度
+struct bvh_treelet_state {
+    std::vector<aabb> bounds;
+    std::vector<double> cost;
+    std::vector<uint32_t> prim_count;
+    std::vector<int> height;
+};
+
+constexpr int bvh_treelet_leaves = 7;
+
+/// @brief 自底向上计算 tree.nodes[index] 为根的子树的包围盒与代价
+/// @param depth 当前深度，只把上面几层的子树作为并行任务
+inline void treelet_init_subtree(const bvh_build_tree& tree, bvh_treelet_state& state, uint32_t index, int depth,
+    const bvh_build_options& options) {
+    const bvh_build_node& node = tree.nodes[index];
+    if (node.count > 0) {
+        state.bounds[index] = primitive_bounds(tree.prims, node.first, node.first + node.count);
+        state.cost[index] = options.intersect_cost * state.bounds[index].surface_area() * node.count;
+        state.prim_count[index] = node.count;
+        state.height[index] = 0;
+        return;
+    }
+
+    uint32_t left = node.child[0], right = node.child[1];
+    #pragma omp task default(shared) firstprivate(left) if (depth < 6)
+    treelet_init_subtree(tree, state, left, depth + 1, options);
+    treelet_init_subtree(tree, state, right, depth + 1, options);
+    #pragma omp taskwait
+
+    state.bounds[index] = surrounding_box(state.bounds[left], state.bounds[right]);
+    state.cost[index] = options.traversal_cost * state.bounds[index].surface_area() + state.cost[left] + state.cost[right];
+    state.prim_count[index] = state.prim_count[left] + state.prim_count[right];
+    state.height[index] = 1 + std::max(state.height[left], state.height[right]);
+}
+
+/// @brief 以 root 为根取出最多 7 个叶子的树片 (不断展开表面积最大的内部节点)，
+/// 对叶子的所有子集做动态规划求出 SAH 代价最小的拓扑，代价更低时复用原来的内部节点重建树片
+/// @param depth root 的深度，新拓扑会使整棵树超过 bvh_max_depth 时保持原样
+inline void restructure_treelet(bvh_build_tree& tree, bvh_treelet_state& state, uint32_t root, int depth,
+    const bvh_build_options& options) {
+    uint32_t leaves[bvh_treelet_leaves];
+    uint32_t internals[bvh_treelet_leaves - 2];
+    int leaf_count = 2, internal_count = 0;
+    leaves[0] = tree.nodes[root].child[0];
+    leaves[1] = tree.nodes[root].child[1];
+
+    while (leaf_count < bvh_treelet_leaves) {
+        int best = -1;
+        double best_area = -1.0;
+        for (int i = 0; i < leaf_count; i++) {
+            if (tree.nodes[leaves[i]].count > 0) continue;
+            double area = state.bounds[leaves[i]].surface_area();
+            if (area > best_area) {
+                best_area = area;
+                best = i;
+            }
+        }
+        if (best < 0) break;
+
+        uint32_t expand = leaves[best];
+        internals[internal_count++] = expand;
+        leaves[best] = tree.nodes[expand].child[0];
+        leaves[leaf_count++] = tree.nodes[expand].child[1];
+    }
+    // 只有两个叶子时拓扑唯一
+    if (leaf_count < 3) return;
+
+    const int subsets = 1 << leaf_count;
+    aabb subset_box[1 << bvh_treelet_leaves];
+    double best_cost[1 << bvh_treelet_leaves];
+    uint8_t best_split[1 << bvh_treelet_leaves];
+
+    // 子集的真子集数值上一定更小，按数值递增的顺序处理即可保证子问题先求解
+    for (int set = 1; set < subsets; set++) {
+        int low = set & -set;
+        int i = lowest_bit((uint32_t)low);
+        int rest = set ^ low;
+        subset_box[set] = rest ? surrounding_box(subset_box[rest], state.bounds[leaves[i]]) : state.bounds[leaves[i]];
+
+        if (!rest) {
+            best_cost[set] = state.cost[leaves[i]];
+            continue;
+        }
+
+        // 只枚举包含最低位的一侧，每种划分只计算一次
+        double best = INFINITY;
+        int split = 0;
+        for (int part = (set - 1) & set; part; part = (part - 1) & set) {
+            if (!(part & low)) continue;
+            double cost = best_cost[part] + best_cost[set ^ part];
+            if (cost < best) {
+                best = cost;
+                split = part;
+            }
+        }
+        best_cost[set] = options.traversal_cost * subset_box[set].surface_area() + best;
+        best_split[set] = (uint8_t)split;
+    }
+
+    const int full = subsets - 1;
+    if (best_cost[full] >= state.cost[root] * (1.0 - 1e-9)) return;
+
+    // 重排可能把较高的子树移到更深处
+    auto subset_height = [&](auto&& self, int set) -> int {
+        if ((set & (set - 1)) == 0) return state.height[leaves[lowest_bit((uint32_t)set)]];
+        return 1 + std::max(self(self, best_split[set]), self(self, set ^ best_split[set]));
+    };
+    if (depth + subset_height(subset_height, full) > bvh_max_depth) return;
+
+    // 按最优划分自顶向下重建，内部节点复用树片中原有的下标
+    int next_internal = 0;
+    auto assign = [&](auto&& self, uint32_t index, int set) -> void {
+        int part[2] = {best_split[set], set ^ best_split[set]};
+        uint32_t child[2];
+        for (int c = 0; c < 2; c++) {
+            if ((part[c] & (part[c] - 1)) == 0) {
+                child[c] = leaves[lowest_bit((uint32_t)part[c])];
+            } else {
+                child[c] = internals[next_internal++];
+                self(self, child[c], part[c]);
+            }
+        }
+
+        // 划分轴取两个子节点中心相距最远的轴，并保证左子节点在该轴的负方向一侧，遍历时据此决定访问顺序
+        vec3 d = state.bounds[child[1]].centroid() - state.bounds[child[0]].centroid();
+        int axis = (std::abs(d.x) > std::abs(d.y) && std::abs(d.x) > std::abs(d.z)) ? 0 : (std::abs(d.y) > std::abs(d.z) ? 1 : 2);
+        if (d[axis] < 0.0) std::swap(child[0], child[1]);
+
+        bvh_build_node& node = tree.nodes[index];
+        node.child[0] = child[0];
+        node.child[1] = child[1];
+        node.count = 0;
+        node.axis = (uint8_t)axis;
+
+        state.bounds[index] = subset_box[set];
+        state.cost[index] = best_cost[set];
+        state.prim_count[index] = state.prim_count[child[0]] + state.prim_count[child[1]];
+        state.height[index] = 1 + std::max(state.height[child[0]], state.height[child[1]]);
+    };
+    assign(assign, root, full);
+}
+
+inline void optimize_treelets_subtree(bvh_build_tree& tree, bvh_treelet_state& state, uint32_t index, int depth,
+    const bvh_build_options& options) {
+    if (tree.nodes[index].count > 0) return;
+
+    // 先优化两棵子树，不同子树中的树片互不相交，可以并行处理
+    uint32_t left = tree.nodes[index].child[0], right = tree.nodes[index].child[1];
+    if (state.prim_count[index] >= options.parallel_threshold) {
+        #pragma omp task default(shared) firstprivate(left, depth)
+        optimize_treelets_subtree(tree, state, left, depth + 1, options);
+        optimize_treelets_subtree(tree, state, right, depth + 1, options);
+        #pragma omp taskwait
+    } else {
+        optimize_treelets_subtree(tree, state, left, depth + 1, options);
+        optimize_treelets_subtree(tree, state, right, depth + 1, options);
+    }
+
+    restructure_treelet(tree, state, index, depth, options);
+}
+
+/// @brief 树片重构 (Karras & Aila 2013)：自底向上在每个内部节点处重排以它为根的树片，重复 options.treelet_passes 遍
+/// 只改变内部节点之间的连接关系，叶子与 prims 不变，可以接在任何构建算法之后
+inline void optimize_treelets(bvh_build_tree& tree, const bvh_build_options& options) {
+    if (tree.empty() || options.treelet_passes <= 0 || tree.nodes[0].count > 0) return;
+
+    bvh_treelet_state state;
+    state.bounds.resize(tree.nodes.size());
+    state.cost.resize(tree.nodes.size());
+    state.prim_count.resize(tree.nodes.size());
+    state.height.resize(tree.nodes.size());
+
+    bool parallel = tree.prims.size() >= options.parallel_threshold;
+    #pragma omp parallel if (parallel)
+    {
+        #pragma omp single
+        {
+            treelet_init_subtree(tree, state, 0, 0, options);
+            for (int pass = 0; pass < options.treelet_passes; pass++) optimize_treelets_subtree(tree, state, 0, 0, options);
+        }
+    }
+}
+
+/// @brief 构建树的深度 (根到最深叶子的边数)
+inline int bvh_tree_depth(const bvh_build_tree& tree) {
+    if (tree.empty()) return 0;
+
+    int max_depth = 0;
+    std::vector<std::pair<uint32_t, int>> pending{{0u, 0}};
+    while (!pending.empty()) {
+        auto [index, depth] = pending.back();
+        pending.pop_back();
+        const bvh_build_node& node = tree.nodes[index];
+        if (node.count > 0) {
+            max_depth = std::max(max_depth, depth);
+        } else {
+            pending.push_back({node.child[0], depth + 1});
+            pending.push_back({node.child[1], depth + 1});
+        }
+    }
+    return max_depth;
+}
+
+/// @brief 按 options.method 选择构建算法，需要时再做树片重构
+inline bvh_build_tree build_bvh(std::vector<bvh_primitive> prims, const bvh_build_options& options) {
+    bvh_build_tree tree = options.method == bvh_build_method::sah
+        ? build_bvh_sah(std::move(prims), options)
+        : build_bvh_morton(std::move(prims), options);
+    optimize_treelets(tree, options);
+    assert(bvh_tree_depth(tree) <= bvh_max_depth);
+    return tree;
+}
+
+/// @brief 从 objects[start, end) 构建二叉 BVH
+inline bvh_build_tree build_bvh(const std::vector<std::shared_ptr<Hittable>>& objects, size_t start, size_t end,
+    double time0, double time1, const bvh_build_options& options) {
+    return build_bvh(make_bvh_primitives(objects, start, end, time0, time1, options.parallel_threshold), options);
+}
@@ -0,0 +1,326 @@
+#pragma once
+
+#include "ragine.h"
+#include "wide_bvh.h"
+#include <cstring>
+
+/// @brief 压缩的 8 叉 BVH 节点 (80 字节，全精度的 wide_bvh_node<8> 为 288 字节)
+/// 子节点包围盒以父节点的局部网格量化成 8 位整数：第 i 个子节点在 axis 轴上的范围为
+/// origin[axis] + [q_min, q_max] * 2^exponent[axis]，量化时向外取整，包围盒只会变大
+/// 内部子节点在 nodes 中从 child_base 开始连续存放，叶子的物体在 primitives 中从 primitive_base 开始按槽位顺序连续存放
+struct alignas(16) compressed_bvh_node {
+    float origin[3];
+    int8_t exponent[3];
+    uint8_t internal_mask;  // 第 i 位为 1 表示子节点 i 为内部节点
+    uint32_t child_base;
+    uint32_t primitive_base;
+    uint8_t count[8];       // 叶子子节点的物体数量，内部子节点与空槽位为 0
+    uint8_t q_min[3][8];
+    uint8_t q_max[3][8];
+};
+
+static_assert(sizeof(compressed_bvh_node) == 80, "compressed_bvh_node should stay 80 bytes");
+
+/// @brief 2^exponent (float)，直接构造指数位
+inline float exponent_scale(int8_t exponent) {
+    uint32_t bits = (uint32_t)(exponent + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return scale;
+}
+
+/// @brief 二进制中 1 的个数
+inline uint32_t bit_count(uint32_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (uint32_t)__builtin_popcount(mask);
+#else
+    uint32_t n = 0;
+    for (; mask; mask &= mask - 1) n++;
+    return n;
+#endif
+}
+
+/// @brief 物体数量不为 0 的子节点 (叶子) 掩码
+inline uint32_t leaf_mask(const compressed_bvh_node& node) {
+#if defined(RAGINE_WIDE_SSE)
+    __m128i counts = _mm_loadl_epi64((const __m128i*)node.count);
+    return ~(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(counts, _mm_setzero_si128())) & 0xffu;
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < 8; i++) mask |= (node.count[i] > 0 ? 1u : 0u) << i;
+    return mask;
+#endif
+}
+
+/// @brief 解码全部 8 个子节点的包围盒并做 slab 测试
+/// @param t_near 输出每个子节点的进入距离
+/// @return 命中的子节点掩码
+inline uint32_t compressed_slab_test(const compressed_bvh_node& node, const wide_ray& wr,
+    float t_min, float t_max, float t_near[8]) {
+    uint32_t valid = node.internal_mask | leaf_mask(node);
+
+    // t = (origin + q * scale - org) * inv_dir = q * (scale * inv_dir) + (origin - org) * inv_dir
+    // 与 wide_slab_test 相同，下界与上界分别使用向外放宽的两个起点
+    float s[3], o_min[3], o_max[3];
+    for (int axis = 0; axis < 3; axis++) {
+        s[axis] = exponent_scale(node.exponent[axis]) * wr.inv_dir[axis];
+        o_min[axis] = (node.origin[axis] - wr.org_min[axis]) * wr.inv_dir[axis];
+        o_max[axis] = (node.origin[axis] - wr.org_max[axis]) * wr.inv_dir[axis];
+    }
+
+    // 由运行时选择的核心完成 (SSE2 / SSE4.1 零扩展，或 AVX2 一次 8 个)
+    return active_kernels().quantized_slab_test8(node.q_min, node.q_max, s, o_min, o_max, t_min, t_max, t_near) & valid;
+}
+
+/// @brief 压缩 8 叉 BVH：节点占用约为 OBVH 的 1/3.6，适合节点数据远超缓存容量的大场景
+/// 先构建二叉 LinearBVH，再按与 WideBVH 相同的方式折叠，最后量化子节点包围盒
+class CompressedBVH : public Hittable {
+public:
+    aabb box;
+    std::vector<compressed_bvh_node> nodes;
+    std::vector<std::shared_ptr<Hittable>> primitives;
+
+    CompressedBVH() {}
+
+    /// @brief 从 HittableList 构建压缩 BVH
+    /// @param time0 快门开启时间
+    /// @param time1 快门关闭时间
+    /// @param options 二叉树阶段的构建参数，叶子大小不超过 255
+    CompressedBVH(const HittableList& list, double time0, double time1, const bvh_build_options& options = bvh_build_options()) {
+        bvh_build_options binary_options = options;
+        binary_options.max_leaf_size = std::min(options.max_leaf_size, 255);
+
+        LinearBVH binary(list, time0, time1, binary_options);
+        if (binary.nodes.empty()) return;
+
+        box = binary.box;
+        primitives.reserve(binary.primitives.size());
+        nodes.reserve(binary.nodes.size() / 4 + 1);
+        nodes.emplace_back();
+        encode(binary, 0, 0);
+    }
+
+    virtual bool is_hit(const ray& r, hit& record, double t_min, double t_max) const override {
+        return deferred_hit(r, record, t_min, t_max);
+    }
+
+    virtual bool intersect(const ray& r, double t_min, double t_max, hit_candidate& candidate) const override {
+        if (nodes.empty()) return false;
+
+        wide_ray wr = make_wide_ray(r, box);
+
+        entry stack[wide_stack_size(8)];
+        int stack_size = 0;
+        stack[stack_size++] = {0, 0, (float)t_min};
+
+        bool hit_anything = false;
+        double closest_so_far = t_max;
+        float t_near[8];
+
+        while (stack_size > 0) {
+            entry current = stack[--stack_size];
+            if (current.t_near > closest_so_far) continue;
+
+            if (current.count > 0) {
+                RAGINE_BVH_COUNT(primitive_tests, current.count);
+                for (uint32_t i = 0; i < current.count; i++) {
+                    if (primitives[current.index + i]->intersect(r, t_min, closest_so_far, candidate)) {
+                        hit_anything = true;
+                        closest_so_far = candidate.time;
+                    }
+                }
+                continue;
+            }
+
+            const compressed_bvh_node& node = nodes[current.index];
+            RAGINE_BVH_COUNT(node_visits, 1);
+            float t_far = (float)closest_so_far * 1.0001f;
+            uint32_t mask = compressed_slab_test(node, wr, (float)t_min, t_far, t_near);
+
+            // 命中的子节点按距离从远到近压栈，出栈时先访问最近的子节点
+            int first = stack_size;
+            while (mask) {
+                int i = lowest_bit(mask);
+                mask &= mask - 1;
+
+                entry e = child_entry(node, i);
+                e.t_near = t_near[i];
+                assert(stack_size < wide_stack_size(8));
+                int j = stack_size++;
+                while (j > first && stack[j - 1].t_near < e.t_near) {
+                    stack[j] = stack[j - 1];
+                    j--;
+                }
+                stack[j] = e;
+            }
+        }
+
+        return hit_anything;
+    }
+
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        if (nodes.empty()) return false;
+
+        wide_ray wr = make_wide_ray(r, box);
+
+        entry_index stack[wide_stack_size(8)];
+        int stack_size = 0;
+        stack[stack_size++] = {0, 0};
+
+        float t_far = (float)t_max * 1.0001f;
+        float t_near[8];
+
+        while (stack_size > 0) {
+            entry_index current = stack[--stack_size];
+
+            if (current.count > 0) {
+                for (uint32_t i = 0; i < current.count; i++) {
+                    RAGINE_BVH_COUNT(primitive_tests, 1);
+                    if (primitives[current.index + i]->is_occluded(r, t_min, t_max)) return true;
+                }
+                continue;
+            }
+
+            const compressed_bvh_node& node = nodes[current.index];
+            RAGINE_BVH_COUNT(node_visits, 1);
+            uint32_t mask = compressed_slab_test(node, wr, (float)t_min, t_far, t_near);
+            while (mask) {
+                int i = lowest_bit(mask);
+                mask &= mask - 1;
+                entry e = child_entry(node, i);
+                assert(stack_size < wide_stack_size(8));
+                stack[stack_size++] = {e.index, e.count};
+            }
+        }
+
+        return false;
+    }
+
+    virtual bool bounding_box(double t0, double t1, aabb& output_box) const override {
+        if (nodes.empty()) return false;
+        output_box = box;
+        return true;
+    }
+
+    virtual vec3 get_position() const override {
+        return {0.0, 0.0, 0.0};
+    }
+
+    /// @brief 统计节点数量、深度与期望遍历代价 (SAH cost)，按量化后的包围盒计算
+    bvh_stats stats(const bvh_build_options& options = bvh_build_options()) const {
+        bvh_stats result;
+        if (nodes.empty()) return result;
+
+        double root_area = box.surface_area();
+        std::vector<std::pair<uint32_t, size_t>> pending{{0, 1}};
+        while (!pending.empty()) {
+            auto [index, depth] = pending.back();
+            pending.pop_back();
+
+            const compressed_bvh_node& node = nodes[index];
+            aabb node_box = empty_box();
+            result.node_count++;
+            result.max_depth = std::max(result.max_depth, depth);
+
+            for (int i = 0; i < 8; i++) {
+                bool internal = node.internal_mask & (1u << i);
+                if (!internal && node.count[i] == 0) continue;
+
+                aabb child = child_bounds(node, i);
+                node_box = surrounding_box(node_box, child);
+                if (internal) {
+                    pending.push_back({child_entry(node, i).index, depth + 1});
+                } else {
+                    result.leaf_count++;
+                    double weight = root_area > 0.0 ? child.surface_area() / root_area : 1.0;
+                    result.sah_cost += options.intersect_cost * weight * node.count[i];
+                }
+            }
+            result.sah_cost += options.traversal_cost * (root_area > 0.0 ? node_box.surface_area() / root_area : 1.0);
+        }
+        return result;
+    }
+
+    /// @brief 节点数组占用的字节数
+    size_t node_bytes() const { return nodes.size() * sizeof(compressed_bvh_node); }
+
+private:
+    struct entry { uint32_t index; uint32_t count; float t_near; };
+    struct entry_index { uint32_t index; uint32_t count; };
+
+    /// @brief 子节点 i 在 nodes (内部节点) 或 primitives (叶子) 中的位置
+    static entry child_entry(const compressed_bvh_node& node, int i) {
+        uint32_t below = (1u << i) - 1;
+        if (node.internal_mask & (1u << i)) {
+            return {node.child_base + bit_count(node.internal_mask & below), 0, 0.0f};
+        }
+
+        uint32_t offset = 0;
+        for (int j = 0; j < i; j++) offset += node.count[j];
+        return {node.primitive_base + offset, node.count[i], 0.0f};
+    }
+
+    static aabb child_bounds(const compressed_bvh_node& node, int i) {
+        vec3 lo, hi;
+        for (int axis = 0; axis < 3; axis++) {
+            double scale = exponent_scale(node.exponent[axis]);
+            lo[axis] = node.origin[axis] + node.q_min[axis][i] * scale;
+            hi[axis] = node.origin[axis] + node.q_max[axis][i] * scale;
+        }
+        return aabb(lo, hi);
+    }
+
+    /// @brief 把 binary[binary_index] 折叠、量化后写入 nodes[node_index]，内部子节点递归写入新分配的连续区间
+    void encode(const LinearBVH& binary, uint32_t binary_index, uint32_t node_index) {
+        std::vector<uint32_t> children = wide_children(binary.nodes, binary_index, 8);
+
+        compressed_bvh_node node;
+        std::memset(&node, 0, sizeof(node));
+
+        aabb bounds = empty_box();
+        for (uint32_t c : children) bounds = surrounding_box(bounds, node_bounds(binary.nodes[c]));
+
+        double scale[3];
+        for (int axis = 0; axis < 3; axis++) {
+            node.origin[axis] = round_down_float(bounds.minimum[axis]);
+            double extent = bounds.maximum[axis] - node.origin[axis];
+
+            // 取最小的 2 的幂使 extent / 2^e 不超过 255
+            int e = extent > 0.0 ? (int)std::ceil(std::log2(extent / 255.0)) : -126;
+            e = std::max(-126, std::min(127, e));
+            while (e < 127 && std::ceil(extent / std::ldexp(1.0, e)) > 255.0) e++;
+            node.exponent[axis] = (int8_t)e;
+            scale[axis] = std::ldexp(1.0, e);
+        }
+
+        uint32_t internal_count = 0;
+        node.primitive_base = (uint32_t)primitives.size();
+        for (int i = 0; i < (int)children.size(); i++) {
+            const linear_bvh_node& c = binary.nodes[children[i]];
+            for (int axis = 0; axis < 3; axis++) {
+                // 向外取整：q_min 向下，q_max 向上
+                double lo = std::floor((c.bounds_min[axis] - node.origin[axis]) / scale[axis]);
+                double hi = std::ceil((c.bounds_max[axis] - node.origin[axis]) / scale[axis]);
+                node.q_min[axis][i] = (uint8_t)std::max(0.0, std::min(255.0, lo));
+                node.q_max[axis][i] = (uint8_t)std::max(0.0, std::min(255.0, hi));
+            }
+
+            if (c.count > 0) {
+                node.count[i] = (uint8_t)c.count;
+                for (uint32_t p = 0; p < c.count; p++) primitives.push_back(binary.primitives[c.offset + p]);
+            } else {
+                node.internal_mask |= 1u << i;
+                internal_count++;
+            }
+        }
+
+        node.child_base = (uint32_t)nodes.size();
+        nodes[node_index] = node;
+        nodes.resize(nodes.size() + internal_count);
+
+        uint32_t next = node.child_base;
+        for (int i = 0; i < (int)children.size(); i++) {
+            if (binary.nodes[children[i]].count == 0) encode(binary, children[i], next++);
+        }
+    }
+};
@@ -0,0 +1,341 @@
+#pragma once
+
+#include "ragine.h"
+#include "../ray_tracing/object.h"
+#include "bvh_build.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/// @brief 均匀网格构建参数
+struct grid_options {
+    double density = 1.0;           // 平均每个物体对应的格子数，越大格子越细，random_world 的小球阵列中 1 最快
+    int max_resolution = 512;       // 每个轴的最大格子数
+    double hashed_ratio = 4.0;      // 总格子数超过 物体-格子 引用数的这个倍数时改用哈希稀疏网格，大范围稀疏场景不必为空格子分配内存
+};
+
+/// @brief 哈希稀疏网格中的一个非空格子
+struct grid_hash_entry {
+    uint64_t key = UINT64_MAX;      // 打包后的格子坐标，UINT64_MAX 表示空槽
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
+/// @brief 均匀网格加速结构：把场景包围盒切成大小相同的格子，每个格子记录与之重叠的物体，
+/// 光线用 3D-DDA 按穿过的顺序逐个访问格子，找到的交点落在当前格子内即可停止
+/// 物体分布均匀、大小相近时 (比如 random_world 的小球阵列) 构建与遍历都可能比 BVH 快
+/// 没有包围盒的物体 (比如 Plane) 单独逐个测试
+class GridAccel : public Hittable {
+public:
+    aabb box;
+    int resolution[3] = {0, 0, 0};
+    vec3 cell_size;
+    bool hashed = false;
+    std::vector<std::shared_ptr<Hittable>> primitives;
+    std::vector<std::shared_ptr<Hittable>> unbounded;
+    std::vector<uint32_t> cell_start;       // 均匀网格：第 i 个格子的物体为 cell_items[cell_start[i], cell_start[i + 1])
+    std::vector<grid_hash_entry> table;     // 哈希网格：开放寻址表，大小为 2 的幂
+    std::vector<uint32_t> cell_items;       // 各格子的物体下标 (primitives 中)，按格子连续存放
+
+    GridAccel() {}
+
+    /// @brief 从 HittableList 构建均匀网格
+    /// @param time0 快门开启时间
+    /// @param time1 快门关闭时间
+    GridAccel(const HittableList& list, double time0, double time1, const grid_options& options = grid_options())
+        : GridAccel(list.objects, time0, time1, options) {}
+
+    GridAccel(const std::vector<std::shared_ptr<Hittable>>& objects, double time0, double time1,
+        const grid_options& options = grid_options()) {
+        std::vector<aabb> boxes;
+        box = empty_box();
+        for (const auto& object : objects) {
+            aabb object_box;
+            if (object->bounding_box(time0, time1, object_box)) {
+                primitives.push_back(object);
+                boxes.push_back(object_box);
+                box = surrounding_box(box, object_box);
+            } else {
+                unbounded.push_back(object);
+            }
+        }
+        if (primitives.empty()) return;
+
+        choose_resolution(options);
+
+        // 每个物体覆盖的格子范围，两遍扫描：先计数再填充，得到按格子连续存放的物体数组
+        std::vector<uint32_t> ranges(primitives.size() * 6);
+        long long count = (long long)primitives.size();
+        #pragma omp parallel for schedule(static) if (count >= 65536)
+        for (long long i = 0; i < count; i++) {
+            for (int axis = 0; axis < 3; axis++) {
+                ranges[i * 6 + axis] = cell_coordinate(boxes[i].minimum[axis], axis);
+                ranges[i * 6 + 3 + axis] = cell_coordinate(boxes[i].maximum[axis], axis);
+            }
+        }
+
+        // 引用数是非空格子数的上界，格子数远多于它时大部分格子必然为空
+        size_t references = 0;
+        for (size_t i = 0; i < primitives.size(); i++) {
+            const uint32_t* range = &ranges[i * 6];
+            references += (size_t)(range[3] - range[0] + 1) * (range[4] - range[1] + 1) * (range[5] - range[2] + 1);
+        }
+
+        size_t cell_count = (size_t)resolution[0] * resolution[1] * resolution[2];
+        hashed = cell_count > options.hashed_ratio * references;
+        if (hashed) build_hashed(ranges, references);
+        else build_uniform(ranges, cell_count);
+    }
+
+    virtual bool is_hit(const ray& r, hit& record, double t_min, double t_max) const override {
+        return deferred_hit(r, record, t_min, t_max);
+    }
+
+    virtual bool intersect(const ray& r, double t_min, double t_max, hit_candidate& candidate) const override {
+        bool hit_anything = false;
+        double closest_so_far = t_max;
+
+        for (const auto& object : unbounded) {
+            if (object->intersect(r, t_min, closest_so_far, candidate)) {
+                hit_anything = true;
+                closest_so_far = candidate.time;
+            }
+        }
+
+        // 邮箱：记录最近测试过的物体，跨越多个格子的物体不会被同一条光线重复测试
+        // 直接映射到栈上的小数组，无需任何共享状态，多线程渲染时也是安全的
+        uint32_t mailbox[mailbox_size];
+        std::fill(mailbox, mailbox + mailbox_size, UINT32_MAX);
+
+        walk(r, t_min, closest_so_far, [&](uint32_t first, uint32_t count, double cell_exit) {
+            RAGINE_BVH_COUNT(node_visits, 1);
+            for (uint32_t i = first; i < first + count; i++) {
+                uint32_t index = cell_items[i];
+                if (mailbox[index % mailbox_size] == index) continue;
+                mailbox[index % mailbox_size] = index;
+
+                RAGINE_BVH_COUNT(primitive_tests, 1);
+                if (primitives[index]->intersect(r, t_min, closest_so_far, candidate)) {
+                    hit_anything = true;
+                    closest_so_far = candidate.time;
+                }
+            }
+            // 交点可能位于后面的格子里，只有落在当前格子内时才能确定它是最近的
+            return closest_so_far <= cell_exit;
+        });
+
+        return hit_anything;
+    }
+
+    /// @brief 沿光线逐格测试，第一个交点出现时立即返回，不需要判断交点是否在当前格子内
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        for (const auto& object : unbounded) {
+            if (object->is_occluded(r, t_min, t_max)) return true;
+        }
+
+        uint32_t mailbox[mailbox_size];
+        std::fill(mailbox, mailbox + mailbox_size, UINT32_MAX);
+        bool occluded = false;
+
+        // 任何交点都能确定遮挡，不必比较格子的出口距离
+        walk(r, t_min, t_max, [&](uint32_t first, uint32_t count, double) {
+            RAGINE_BVH_COUNT(node_visits, 1);
+            for (uint32_t i = first; i < first + count; i++) {
+                uint32_t index = cell_items[i];
+                if (mailbox[index % mailbox_size] == index) continue;
+                mailbox[index % mailbox_size] = index;
+
+                RAGINE_BVH_COUNT(primitive_tests, 1);
+                if (primitives[index]->is_occluded(r, t_min, t_max)) {
+                    occluded = true;
+                    return true;
+                }
+            }
+            return false;
+        });
+
+        return occluded;
+    }
+
+    virtual bool bounding_box(double t0, double t1, aabb& output_box) const override {
+        if (!unbounded.empty() || primitives.empty()) return false;
+        output_box = box;
+        return true;
+    }
+
+    virtual vec3 get_position() const override {
+        return {0.0, 0.0, 0.0};
+    }
+
+    /// @brief 非空格子数量
+    size_t occupied_cells() const {
+        if (hashed) {
+            return std::count_if(table.begin(), table.end(), [](const grid_hash_entry& e) { return e.key != UINT64_MAX; });
+        }
+        size_t occupied = 0;
+        for (size_t i = 0; i + 1 < cell_start.size(); i++) occupied += cell_start[i + 1] > cell_start[i];
+        return occupied;
+    }
+
+private:
+    static constexpr uint32_t mailbox_size = 32;
+
+    /// @brief 按物体密度选择分辨率：总格子数约为 density * 物体数，格子尽量接近立方体
+    void choose_resolution(const grid_options& options) {
+        vec3 extent = box.maximum - box.minimum;
+        double max_extent = std::max(extent.x, std::max(extent.y, extent.z));
+        double volume = 1.0;
+        for (int axis = 0; axis < 3; axis++) volume *= std::max(extent[axis], max_extent * 1e-3);
+
+        double cells_per_unit = std::cbrt(options.density * primitives.size() / volume);
+        for (int axis = 0; axis < 3; axis++) {
+            int n = (int)std::lround(extent[axis] * cells_per_unit);
+            resolution[axis] = std::clamp(n, 1, options.max_resolution);
+        }
+        cell_size = vec3{extent.x / resolution[0], extent.y / resolution[1], extent.z / resolution[2]};
+    }
+
+    uint32_t cell_coordinate(double position, int axis) const {
+        if (cell_size[axis] <= 0.0) return 0;
+        int cell = (int)((position - box.minimum[axis]) / cell_size[axis]);
+        return (uint32_t)std::clamp(cell, 0, resolution[axis] - 1);
+    }
+
+    uint64_t cell_key(uint32_t x, uint32_t y, uint32_t z) const {
+        return ((uint64_t)z << 42) | ((uint64_t)y << 21) | (uint64_t)x;
+    }
+
+    template <typename F>
+    static void for_each_cell(const uint32_t* range, F&& f) {
+        for (uint32_t z = range[2]; z <= range[5]; z++)
+            for (uint32_t y = range[1]; y <= range[4]; y++)
+                for (uint32_t x = range[0]; x <= range[3]; x++) f(x, y, z);
+    }
+
+    void build_uniform(const std::vector<uint32_t>& ranges, size_t cell_count) {
+        cell_start.assign(cell_count + 1, 0);
+        auto index = [&](uint32_t x, uint32_t y, uint32_t z) {
+            return ((size_t)z * resolution[1] + y) * resolution[0] + x;
+        };
+
+        for (size_t i = 0; i < primitives.size(); i++) {
+            for_each_cell(&ranges[i * 6], [&](uint32_t x, uint32_t y, uint32_t z) { cell_start[index(x, y, z) + 1]++; });
+        }
+        for (size_t i = 0; i < cell_count; i++) cell_start[i + 1] += cell_start[i];
+
+        std::vector<uint32_t> cursor(cell_start.begin(), cell_start.end() - 1);
+        cell_items.resize(cell_start.back());
+        for (size_t i = 0; i < primitives.size(); i++) {
+            for_each_cell(&ranges[i * 6], [&](uint32_t x, uint32_t y, uint32_t z) {
+                cell_items[cursor[index(x, y, z)]++] = (uint32_t)i;
+            });
+        }
+    }
+
+    /// @brief 在哈希表中查找格子，不存在时返回空槽的位置
+    size_t find_slot(uint64_t key) const {
+        size_t mask = table.size() - 1;
+        size_t slot = (size_t)((key * 0x9e3779b97f4a7c15ull) >> 20) & mask;
+        while (table[slot].key != key && table[slot].key != UINT64_MAX) slot = (slot + 1) & mask;
+        return slot;
+    }
+
+    void build_hashed(const std::vector<uint32_t>& ranges, size_t references) {
+        // 装载率不超过 1/2
+        size_t capacity = 16;
+        while (capacity < references * 2) capacity *= 2;
+        table.assign(capacity, grid_hash_entry());
+
+        for (size_t i = 0; i < primitives.size(); i++) {
+            for_each_cell(&ranges[i * 6], [&](uint32_t x, uint32_t y, uint32_t z) {
+                uint64_t key = cell_key(x, y, z);
+                grid_hash_entry& entry = table[find_slot(key)];
+                entry.key = key;
+                entry.count++;
+            });
+        }
+
+        uint32_t first = 0;
+        for (grid_hash_entry& entry : table) {
+            entry.first = first;
+            first += entry.count;
+            entry.count = 0;
+        }
+
+        cell_items.resize(first);
+        for (size_t i = 0; i < primitives.size(); i++) {
+            for_each_cell(&ranges[i * 6], [&](uint32_t x, uint32_t y, uint32_t z) {
+                grid_hash_entry& entry = table[find_slot(cell_key(x, y, z))];
+                cell_items[entry.first + entry.count++] = (uint32_t)i;
+            });
+        }
+    }
+
+    /// @brief 3D-DDA：按光线穿过的顺序访问 [t_min, t_max] 内的非空格子
+    /// @param visit visit(first, count, cell_exit) 处理一个格子，返回 true 时停止遍历
+    template <typename F>
+    void walk(const ray& r, double t_min, double t_max, F&& visit) const {
+        if (primitives.empty()) return;
+
+        // 光线与网格包围盒求交，得到进入与离开网格的距离
+        double t_enter = t_min, t_exit = t_max;
+        for (int axis = 0; axis < 3; axis++) {
+            double inv_dir = 1.0 / r.dir[axis];
+            double t0 = (box.minimum[axis] - r.origin[axis]) * inv_dir;
+            double t1 = (box.maximum[axis] - r.origin[axis]) * inv_dir;
+            if (inv_dir < 0.0) std::swap(t0, t1);
+            t_enter = t0 > t_enter ? t0 : t_enter;
+            t_exit = t1 < t_exit ? t1 : t_exit;
+            if (t_enter > t_exit) return;
+        }
+
+        int cell[3], step[3], stop[3];
+        double next_crossing[3], delta[3];
+        vec3 entry = r.at(t_enter);
+        for (int axis = 0; axis < 3; axis++) {
+            cell[axis] = (int)cell_coordinate(entry[axis], axis);
+            if (r.dir[axis] > 0.0) {
+                step[axis] = 1;
+                stop[axis] = resolution[axis];
+                next_crossing[axis] = t_enter + (box.minimum[axis] + (cell[axis] + 1) * cell_size[axis] - entry[axis]) / r.dir[axis];
+                delta[axis] = cell_size[axis] / r.dir[axis];
+            } else if (r.dir[axis] < 0.0) {
+                step[axis] = -1;
+                stop[axis] = -1;
+                next_crossing[axis] = t_enter + (box.minimum[axis] + cell[axis] * cell_size[axis] - entry[axis]) / r.dir[axis];
+                delta[axis] = -cell_size[axis] / r.dir[axis];
+            } else {
+                step[axis] = 0;
+                stop[axis] = -1;
+                next_crossing[axis] = INFINITY;
+                delta[axis] = INFINITY;
+            }
+        }
+
+        while (true) {
+            // 下一次穿过的格子边界所在的轴
+            int axis = next_crossing[0] < next_crossing[1]
+                ? (next_crossing[0] < next_crossing[2] ? 0 : 2)
+                : (next_crossing[1] < next_crossing[2] ? 1 : 2);
+            double cell_exit = std::min(next_crossing[axis], t_exit);
+
+            uint32_t first = 0, count = 0;
+            if (hashed) {
+                const grid_hash_entry& entry = table[find_slot(cell_key(cell[0], cell[1], cell[2]))];
+                first = entry.first;
+                count = entry.count;
+            } else {
+                size_t index = ((size_t)cell[2] * resolution[1] + cell[1]) * resolution[0] + cell[0];
+                first = cell_start[index];
+                count = cell_start[index + 1] - first;
+            }
+            if (count > 0 && visit(first, count, cell_exit)) return;
+
+            if (next_crossing[axis] > t_exit) return;
+            cell[axis] += step[axis];
+            if (cell[axis] == stop[axis]) return;
+            next_crossing[axis] += delta[axis];
+        }
+    }
+};
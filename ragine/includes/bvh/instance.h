@@ -0,0 +1,94 @@
+#pragma once
+
+#include "ragine.h"
+#include "../ray_tracing/object.h"
+
+/// @brief 变换包围盒：分别按线性部分的每一项累加最小与最大值 (Arvo 方法)，得到紧致的轴对齐包围盒
+inline aabb transform_box(const affine_transform& t, const aabb& box) {
+    vec3 lo{t.m[0][3], t.m[1][3], t.m[2][3]};
+    vec3 hi = lo;
+
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            double a = t.m[i][j] * box.minimum[j];
+            double b = t.m[i][j] * box.maximum[j];
+            lo[i] += std::min(a, b);
+            hi[i] += std::max(a, b);
+        }
+    }
+    return aabb(lo, hi);
+}
+
+/// @brief 双层加速结构中的实例：引用一个只构建一次的底层结构 (BLAS)，并附带自身的仿射变换
+/// 多个实例共享同一个 BLAS，内存只与不同几何体的数量有关；顶层结构 (TLAS) 直接把实例放进 LinearBVH 等结构即可
+class Instance : public Hittable {
+public:
+    std::shared_ptr<Hittable> blas;
+    affine_transform object_to_world;
+    affine_transform world_to_object;
+
+    /// @brief Instantiate an Instance
+    /// @param geometry 底层几何体 (通常是 LinearBVH / WideBVH)
+    /// @param transform 从物体空间到世界空间的变换，线性部分必须可逆；奇异的变换 (比如某个轴缩放为 0)
+    /// 无法把光线变换回物体空间，这样的实例被忽略：报错并换成空的几何体
+    Instance(const std::shared_ptr<Hittable>& geometry, const affine_transform& transform) :
+        blas(geometry), object_to_world(transform) {
+        if (!transform.is_invertible()) {
+            std::cerr << "ERROR: Instance transform is singular (det = " << transform.determinant()
+                      << "), the instance is ignored.\n";
+            blas = std::make_shared<HittableList>();
+            object_to_world = affine_transform::identity();
+        }
+        world_to_object = object_to_world.inverse();
+    }
+
+    virtual vec3 get_position() const override {
+        return object_to_world.point({0.0, 0.0, 0.0});
+    }
+
+    virtual bool is_hit(const ray& r, hit& record, double t_min, double t_max) const override {
+        return deferred_hit(r, record, t_min, t_max);
+    }
+
+    /// @brief 在物体空间中求交，记下交点所在的实例，finalize_hit 时再由实例变换光线与交点属性
+    virtual bool intersect(const ray& r, double t_min, double t_max, hit_candidate& candidate) const override {
+        // 方向不做单位化，物体空间中的 t 与世界空间相同
+        ray local{world_to_object.point(r.origin), world_to_object.vector(r.dir), r.time};
+        hit_candidate inner;
+        if (!blas->intersect(local, t_min, t_max, inner)) return false;
+
+        if (inner.instance) {
+            // 实例嵌套实例：candidate 只能记录一层实例，退化为由 finalize_hit 重新求交
+            candidate = {inner.time, this};
+            candidate.t_min = t_min;
+        } else {
+            candidate = inner;
+            candidate.instance = this;
+        }
+        return true;
+    }
+
+    virtual void finalize_hit(const ray& r, const hit_candidate& candidate, hit& record) const override {
+        ray local{world_to_object.point(r.origin), world_to_object.vector(r.dir), r.time};
+        if (candidate.object == this) {
+            blas->is_hit(local, record, candidate.t_min, candidate.time);
+        } else {
+            candidate.object->finalize_hit(local, candidate, record);
+        }
+
+        record.position = object_to_world.point(record.position);
+        record.normal = world_to_object.transpose_vector(record.normal).normalize();
+    }
+
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        ray local{world_to_object.point(r.origin), world_to_object.vector(r.dir), r.time};
+        return blas->is_occluded(local, t_min, t_max);
+    }
+
+    virtual bool bounding_box(double t0, double t1, aabb& output_box) const override {
+        aabb local;
+        if (!blas->bounding_box(t0, t1, local)) return false;
+        output_box = transform_box(object_to_world, local);
+        return true;
+    }
+};
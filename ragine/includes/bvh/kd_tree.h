@@ -0,0 +1,367 @@
+#pragma once
+
+#include "ragine.h"
+#include "../ray_tracing/object.h"
+#include "bvh_build.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/// @brief kd 树构建参数
+struct kd_tree_options {
+    double intersect_cost = 80.0;   // 一次物体求交相对于一次节点遍历的代价
+    double traversal_cost = 1.0;
+    double empty_bonus = 0.5;       // 划分出空节点时代价打折，鼓励尽早切掉空白区域
+    int max_leaf_size = 1;          // 物体数不超过该值时直接生成叶子
+    int max_depth = -1;             // 最大深度，-1 表示按物体数自动选择 8 + 1.3 log2(N)
+};
+
+/// @brief kd 树节点 (8 字节)
+/// 低 2 位为 flags：0/1/2 表示内部节点的划分轴，3 表示叶子
+/// 内部节点的下方子节点紧跟在自身之后，上方子节点下标保存在高 30 位
+/// 叶子只有一个物体时直接保存物体下标，否则保存其在 primitive_indices 中的起始位置
+struct kd_tree_node {
+    union {
+        float split;                // 内部节点: 划分平面位置
+        uint32_t one_primitive;     // 单物体叶子: 物体下标
+        uint32_t primitive_offset;  // 多物体叶子: primitive_indices 中的起始位置
+    };
+    union {
+        uint32_t flags;
+        uint32_t primitive_count;   // 叶子: 物体数量 << 2
+        uint32_t above_child;       // 内部节点: 上方子节点下标 << 2
+    };
+
+    void init_leaf(const uint32_t* prims, uint32_t count, std::vector<uint32_t>& primitive_indices) {
+        flags = 3 | (count << 2);
+        if (count == 0) {
+            one_primitive = 0;
+        } else if (count == 1) {
+            one_primitive = prims[0];
+        } else {
+            primitive_offset = (uint32_t)primitive_indices.size();
+            primitive_indices.insert(primitive_indices.end(), prims, prims + count);
+        }
+    }
+
+    void init_interior(int axis, uint32_t above, float position) {
+        split = position;
+        flags = (uint32_t)axis | (above << 2);
+    }
+
+    bool is_leaf() const { return (flags & 3) == 3; }
+    int axis() const { return flags & 3; }
+    uint32_t count() const { return primitive_count >> 2; }
+    uint32_t above() const { return above_child >> 2; }
+};
+
+static_assert(sizeof(kd_tree_node) == 8, "kd_tree_node should stay 8 bytes");
+
+/// @brief SAH 构建的 kd 树：空间被划分为互不重叠的区域，光线按从前到后的顺序访问叶子，
+/// 在当前区域内找到交点即可提前结束；物体可能被多个叶子引用
+/// 没有包围盒的物体 (比如 Plane) 单独逐个测试
+class KdTree : public Hittable {
+public:
+    aabb box;
+    std::vector<kd_tree_node> nodes;
+    std::vector<uint32_t> primitive_indices;
+    std::vector<std::shared_ptr<Hittable>> primitives;
+    std::vector<std::shared_ptr<Hittable>> unbounded;
+
+    KdTree() {}
+
+    /// @brief 从 HittableList 构建 kd 树
+    /// @param time0 快门开启时间
+    /// @param time1 快门关闭时间
+    KdTree(const HittableList& list, double time0, double time1, const kd_tree_options& options = kd_tree_options())
+        : KdTree(list.objects, time0, time1, options) {}
+
+    KdTree(const std::vector<std::shared_ptr<Hittable>>& objects, double time0, double time1,
+        const kd_tree_options& options = kd_tree_options()) : settings(options) {
+        box = empty_box();
+        for (const auto& object : objects) {
+            aabb object_box;
+            if (object->bounding_box(time0, time1, object_box)) {
+                primitives.push_back(object);
+                boxes.push_back(object_box);
+                box = surrounding_box(box, object_box);
+            } else {
+                unbounded.push_back(object);
+            }
+        }
+        if (primitives.empty()) return;
+
+        if (settings.max_depth < 0) settings.max_depth = (int)std::lround(8 + 1.3 * std::log2((double)primitives.size()));
+        settings.max_depth = std::min(settings.max_depth, max_todo - 1);
+
+        for (int axis = 0; axis < 3; axis++) edges[axis].resize(2 * primitives.size());
+        std::vector<uint32_t> prims(primitives.size());
+        for (uint32_t i = 0; i < (uint32_t)prims.size(); i++) prims[i] = i;
+
+        build(box, prims, settings.max_depth, 0);
+
+        // 构建用的临时数据不再需要
+        boxes = std::vector<aabb>();
+        for (auto& axis_edges : edges) axis_edges = std::vector<kd_edge>();
+    }
+
+    virtual bool is_hit(const ray& r, hit& record, double t_min, double t_max) const override {
+        return deferred_hit(r, record, t_min, t_max);
+    }
+
+    virtual bool intersect(const ray& r, double t_min, double t_max, hit_candidate& candidate) const override {
+        bool hit_anything = false;
+        double closest_so_far = t_max;
+
+        for (const auto& object : unbounded) {
+            if (object->intersect(r, t_min, closest_so_far, candidate)) {
+                hit_anything = true;
+                closest_so_far = candidate.time;
+            }
+        }
+
+        traverse(r, t_min, closest_so_far, [&](uint32_t index) {
+            if (primitives[index]->intersect(r, t_min, closest_so_far, candidate)) {
+                hit_anything = true;
+                closest_so_far = candidate.time;
+            }
+            return false;
+        }, closest_so_far);
+
+        return hit_anything;
+    }
+
+    /// @brief 遍历顺序与 is_hit 相同，但第一个交点出现时立即返回
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        for (const auto& object : unbounded) {
+            if (object->is_occluded(r, t_min, t_max)) return true;
+        }
+
+        bool occluded = false;
+        traverse(r, t_min, t_max, [&](uint32_t index) {
+            occluded = primitives[index]->is_occluded(r, t_min, t_max);
+            return occluded;
+        }, t_max);
+
+        return occluded;
+    }
+
+    virtual bool bounding_box(double t0, double t1, aabb& output_box) const override {
+        if (!unbounded.empty() || primitives.empty()) return false;
+        output_box = box;
+        return true;
+    }
+
+    virtual vec3 get_position() const override {
+        return {0.0, 0.0, 0.0};
+    }
+
+    /// @brief 节点数量、叶子数量与最大深度
+    bvh_stats stats() const {
+        bvh_stats result;
+        if (nodes.empty()) return result;
+
+        std::vector<std::pair<uint32_t, size_t>> pending{{0, 1}};
+        while (!pending.empty()) {
+            auto [index, depth] = pending.back();
+            pending.pop_back();
+            result.node_count++;
+            result.max_depth = std::max(result.max_depth, depth);
+            if (nodes[index].is_leaf()) {
+                result.leaf_count++;
+            } else {
+                pending.push_back({index + 1, depth + 1});
+                pending.push_back({nodes[index].above(), depth + 1});
+            }
+        }
+        return result;
+    }
+
+private:
+    /// @brief 物体包围盒在某个轴上的起点或终点
+    struct kd_edge {
+        double t;
+        uint32_t primitive;
+        bool starting;
+
+        bool operator<(const kd_edge& other) const {
+            if (t == other.t) return starting && !other.starting;
+            return t < other.t;
+        }
+    };
+
+    /// @brief 待访问的远端子节点以及光线在其中的区间
+    struct kd_todo {
+        uint32_t node;
+        double t_min, t_max;
+    };
+
+    static constexpr int max_todo = 64;
+    static constexpr uint32_t mailbox_size = 32;
+
+    kd_tree_options settings;
+    std::vector<aabb> boxes;
+    std::vector<kd_edge> edges[3];
+
+    /// @brief 物体包围盒与节点区域的交集 (完美划分)：只按物体真正落在节点内的部分计算代价与归类，
+    /// 跨越划分平面的大物体不会让两侧的节点都显得比实际更满
+    static aabb clip(const aabb& a, const aabb& b) {
+        return aabb(
+            vec3{std::max(a.minimum.x, b.minimum.x), std::max(a.minimum.y, b.minimum.y), std::max(a.minimum.z, b.minimum.z)},
+            vec3{std::min(a.maximum.x, b.maximum.x), std::min(a.maximum.y, b.maximum.y), std::min(a.maximum.z, b.maximum.z)}
+        );
+    }
+
+    /// @brief 深度优先构建，当前节点写入 nodes 末尾，下方子节点紧随其后
+    void build(const aabb& node_box, const std::vector<uint32_t>& prims, int depth, int bad_refines) {
+        uint32_t index = (uint32_t)nodes.size();
+        nodes.emplace_back();
+        uint32_t count = (uint32_t)prims.size();
+
+        if (count <= (uint32_t)settings.max_leaf_size || depth == 0) {
+            nodes[index].init_leaf(prims.data(), count, primitive_indices);
+            return;
+        }
+
+        // 沿每个轴扫描排序后的包围盒端点，计算每个候选平面的 SAH 代价
+        vec3 extent = node_box.maximum - node_box.minimum;
+        double inv_area = 1.0 / node_box.surface_area();
+        double leaf_cost = settings.intersect_cost * count;
+        double best_cost = INFINITY;
+        int best_axis = -1;
+        size_t best_offset = 0;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+        for (int retries = 0; retries < 3 && best_axis == -1; retries++, axis = (axis + 1) % 3) {
+            std::vector<kd_edge>& axis_edges = edges[axis];
+            for (uint32_t i = 0; i < count; i++) {
+                aabb clipped = clip(boxes[prims[i]], node_box);
+                axis_edges[2 * i] = {clipped.minimum[axis], prims[i], true};
+                axis_edges[2 * i + 1] = {clipped.maximum[axis], prims[i], false};
+            }
+            std::sort(axis_edges.begin(), axis_edges.begin() + 2 * count);
+
+            int other0 = (axis + 1) % 3, other1 = (axis + 2) % 3;
+            uint32_t below = 0, above = count;
+            for (size_t i = 0; i < 2 * count; i++) {
+                if (!axis_edges[i].starting) above--;
+
+                // 候选平面按 float 取整后计算，否则取整后可能恰好落在节点边界上，划分出一个空节点而物体一个不少
+                double t = (float)axis_edges[i].t;
+                if (t > node_box.minimum[axis] && t < node_box.maximum[axis]) {
+                    double below_area = 2 * (extent[other0] * extent[other1] + (t - node_box.minimum[axis]) * (extent[other0] + extent[other1]));
+                    double above_area = 2 * (extent[other0] * extent[other1] + (node_box.maximum[axis] - t) * (extent[other0] + extent[other1]));
+                    double bonus = (below == 0 || above == 0) ? settings.empty_bonus : 0.0;
+                    double cost = settings.traversal_cost + settings.intersect_cost * (1.0 - bonus) *
+                        (below_area * inv_area * below + above_area * inv_area * above);
+                    if (cost < best_cost) {
+                        best_cost = cost;
+                        best_axis = axis;
+                        best_offset = i;
+                    }
+                }
+
+                if (axis_edges[i].starting) below++;
+            }
+        }
+
+        if (best_cost > leaf_cost) bad_refines++;
+        if ((best_cost > 4 * leaf_cost && count < 16) || best_axis == -1 || bad_refines == 3) {
+            nodes[index].init_leaf(prims.data(), count, primitive_indices);
+            return;
+        }
+
+        // 节点只保存 float 精度的平面位置，按取整后的平面归类，保证遍历与构建对空间的划分完全一致
+        // 跨越平面的物体两边都有，恰好位于平面上的扁平物体也两边都放
+        float split = (float)edges[best_axis][best_offset].t;
+        std::vector<uint32_t> below_prims, above_prims;
+        for (uint32_t index : prims) {
+            aabb clipped = clip(boxes[index], node_box);
+            bool in_below = clipped.minimum[best_axis] < split;
+            bool in_above = clipped.maximum[best_axis] > split;
+            if (in_below || !in_above) below_prims.push_back(index);
+            if (in_above || !in_below) above_prims.push_back(index);
+        }
+
+        aabb below_box = node_box, above_box = node_box;
+        below_box.maximum[best_axis] = split;
+        above_box.minimum[best_axis] = split;
+
+        build(below_box, below_prims, depth - 1, bad_refines);
+        uint32_t above_index = (uint32_t)nodes.size();
+        nodes[index].init_interior(best_axis, above_index, split);
+        build(above_box, above_prims, depth - 1, bad_refines);
+    }
+
+    /// @brief 从前到后访问光线穿过的叶子
+    /// @param test test(index) 测试一个物体，返回 true 时立即结束遍历
+    /// @param closest 最近交点距离的引用，光线段的起点超过它时不再有更近的交点，提前结束
+    template <typename F>
+    void traverse(const ray& r, double t_min, double t_max, F&& test, const double& closest) const {
+        if (nodes.empty()) return;
+
+        double t_enter = t_min, t_exit = t_max;
+        vec3 inv_dir{1.0 / r.dir.x, 1.0 / r.dir.y, 1.0 / r.dir.z};
+        for (int axis = 0; axis < 3; axis++) {
+            double t0 = (box.minimum[axis] - r.origin[axis]) * inv_dir[axis];
+            double t1 = (box.maximum[axis] - r.origin[axis]) * inv_dir[axis];
+            if (inv_dir[axis] < 0.0) std::swap(t0, t1);
+            t_enter = t0 > t_enter ? t0 : t_enter;
+            t_exit = t1 < t_exit ? t1 : t_exit;
+            if (t_enter > t_exit) return;
+        }
+
+        // 邮箱：跨越多个叶子的物体不会被同一条光线重复测试，与 GridAccel 相同
+        uint32_t mailbox[mailbox_size];
+        std::fill(mailbox, mailbox + mailbox_size, UINT32_MAX);
+
+        kd_todo todo[max_todo];
+        int todo_size = 0;
+        uint32_t current = 0;
+        double segment_min = t_enter, segment_max = t_exit;
+
+        while (true) {
+            if (closest < segment_min) break;
+
+            const kd_tree_node& node = nodes[current];
+            RAGINE_BVH_COUNT(node_visits, 1);
+            if (!node.is_leaf()) {
+                int axis = node.axis();
+                double t_plane = (node.split - r.origin[axis]) * inv_dir[axis];
+
+                // 光线起点所在的一侧先访问
+                bool below_first = r.origin[axis] < node.split || (r.origin[axis] == node.split && r.dir[axis] <= 0.0);
+                uint32_t first = below_first ? current + 1 : node.above();
+                uint32_t second = below_first ? node.above() : current + 1;
+
+                if (t_plane > segment_max || t_plane <= 0.0) {
+                    current = first;
+                } else if (t_plane < segment_min) {
+                    current = second;
+                } else {
+                    todo[todo_size++] = {second, t_plane, segment_max};
+                    current = first;
+                    segment_max = t_plane;
+                }
+                continue;
+            }
+
+            uint32_t count = node.count();
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t index = count == 1 ? node.one_primitive : primitive_indices[node.primitive_offset + i];
+                if (mailbox[index % mailbox_size] == index) continue;
+                mailbox[index % mailbox_size] = index;
+
+                RAGINE_BVH_COUNT(primitive_tests, 1);
+                if (test(index)) return;
+            }
+
+            if (todo_size == 0) break;
+            kd_todo next = todo[--todo_size];
+            current = next.node;
+            segment_min = next.t_min;
+            segment_max = next.t_max;
+        }
+    }
+};
@@ -0,0 +1,662 @@
+#pragma once
+
+#include "ragine.h"
+#include "../ray_tracing/object.h"
+#include "bvh_build.h"
+#include "bvh_cache.h"
+#include "../components/mapped_file.h"
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define RAGINE_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define RAGINE_PREFETCH(address) ((void)0)
+#endif
+
+/// @brief 扁平化 BVH 节点 (32 字节)，所有节点存放在一块连续内存中
+/// 兄弟节点总是相邻存放：内部节点的两个子节点下标为 offset 与 offset + 1，节点之间的先后顺序由 bvh_layout 决定
+struct linear_bvh_node {
+    float bounds_min[3];
+    float bounds_max[3];
+    uint32_t offset;    // 叶子节点: 第一个物体在 primitives 中的下标; 内部节点: 第一个子节点下标
+    uint16_t count;     // 叶子节点的物体数量，0 表示内部节点
+    uint8_t axis;       // 内部节点的划分轴，遍历时据此决定先访问哪个子节点
+    uint8_t pad;
+};
+
+static_assert(sizeof(linear_bvh_node) == 32, "linear_bvh_node should stay 32 bytes");
+
+/// @brief 将 double 向下取整到 float，保证包围盒只会变大不会变小
+inline float round_down_float(double value) {
+    float f = (float)value;
+    return ((double)f > value) ? std::nextafter(f, -INFINITY) : f;
+}
+
+/// @brief 将 double 向上取整到 float
+inline float round_up_float(double value) {
+    float f = (float)value;
+    return ((double)f < value) ? std::nextafter(f, INFINITY) : f;
+}
+
+inline void set_node_bounds(linear_bvh_node& node, const aabb& box) {
+    for (int axis = 0; axis < 3; axis++) {
+        node.bounds_min[axis] = round_down_float(box.minimum[axis]);
+        node.bounds_max[axis] = round_up_float(box.maximum[axis]);
+    }
+}
+
+inline aabb node_bounds(const linear_bvh_node& node) {
+    return aabb(
+        vec3{node.bounds_min[0], node.bounds_min[1], node.bounds_min[2]},
+        vec3{node.bounds_max[0], node.bounds_max[1], node.bounds_max[2]}
+    );
+}
+
+/// @brief 使用预先计算的倒数方向做 slab 测试，光线与距离的标量类型为 T (引擎使用 double，PrecisionScene<float> 使用 float)
+/// @param dir_is_neg 每个轴上光线方向是否为负
+template <typename T>
+inline bool node_slab_test(const linear_bvh_node& node, const ray_t<T>& r, const vec3_t<T>& inv_dir, const int dir_is_neg[3],
+    T t_min, T t_max) {
+    for (int axis = 0; axis < 3; axis++) {
+        T near = dir_is_neg[axis] ? node.bounds_max[axis] : node.bounds_min[axis];
+        T far = dir_is_neg[axis] ? node.bounds_min[axis] : node.bounds_max[axis];
+        T t0 = (near - r.origin[axis]) * inv_dir[axis];
+        T t1 = (far - r.origin[axis]) * inv_dir[axis];
+
+        t_min = t0 > t_min ? t0 : t_min;
+        t_max = t1 < t_max ? t1 : t_max;
+
+        if (t_min > t_max) return false;
+    }
+    return true;
+}
+
+/// @brief 兄弟节点相邻存放的二叉 BVH 的栈式遍历，近端子节点优先，LinearBVH、MotionBVH 与 PrecisionScene 共用
+/// Node 只需提供 offset / count / axis，包围盒的表示与测试方式由 slab 决定
+/// 每下降一层最多压栈一个节点，树的深度不能超过 bvh_max_depth (build_bvh 保证，外部的树在扁平化时检查)
+/// @param slab 包围盒测试 slab(node)，调用方在其中读取自己当前的最近交点距离
+/// @param leaf 叶子回调 leaf(node)，返回 true 时立即结束遍历 (比如可见性查询找到了交点)
+/// @return 是否由 leaf 提前结束
+template <typename Node, typename Slab, typename Leaf>
+inline bool traverse_bvh(const Node* nodes, const int dir_is_neg[3], Slab&& slab, Leaf&& leaf) {
+    uint32_t stack[bvh_max_depth];
+    int stack_size = 0;
+    uint32_t current = 0;
+
+    while (true) {
+        const Node& node = nodes[current];
+        RAGINE_BVH_COUNT(node_visits, 1);
+        if (slab(node)) {
+            if (node.count > 0) {
+                if (leaf(node)) return true;
+                if (stack_size == 0) break;
+                current = stack[--stack_size];
+            } else {
+                // 光线沿该轴负方向前进时先访问第二个子节点，远端子节点入栈并预取
+                uint32_t near = node.offset + dir_is_neg[node.axis];
+                uint32_t far = node.offset + 1 - dir_is_neg[node.axis];
+                RAGINE_PREFETCH(&nodes[far]);
+                assert(stack_size < bvh_max_depth);
+                stack[stack_size++] = far;
+                current = near;
+            }
+        } else {
+            if (stack_size == 0) break;
+            current = stack[--stack_size];
+        }
+    }
+    return false;
+}
+
+/// @brief 无栈遍历时到达当前节点的方向
+enum class bvh_traversal_from : uint8_t {
+    parent,     // 从父节点下降到近端子节点
+    sibling,    // 近端子树处理完毕，转到远端兄弟节点
+    child       // 远端子树处理完毕，回到父节点
+};
+
+/// @brief 无栈遍历的全部逐光线状态，大小固定
+/// 遍历可以在任意一步暂停，之后凭这份状态继续，调度器可以同时推进大量光线
+struct bvh_stackless_state {
+    double closest;                                     // 当前最近交点距离
+    uint32_t current = 0;
+    bvh_traversal_from from = bvh_traversal_from::parent;
+    bool finished = false;
+    bool hit_anything = false;
+};
+
+class LinearBVH : public Hittable {
+public:
+    aabb box;
+    mapped_array<linear_bvh_node> nodes;                  // 构建得到时自己持有，从缓存加载时直接引用映射文件
+    std::vector<std::shared_ptr<Hittable>> primitives;   // 按叶子顺序紧密排列的物体
+    double build_sah_cost = 0.0;                          // 构建完成时的 SAH 代价，refit 时用于衡量树质量
+    std::vector<uint32_t> parents;                        // 第 k 对兄弟节点 (下标 2k+1 与 2k+2) 的父节点下标，供无栈遍历回溯
+    std::vector<uint32_t> refit_order;                    // 内部节点按高度 (到最深叶子的层数) 排列，refit 时逐层自底向上处理
+    std::vector<uint32_t> refit_levels;                   // 高度为 h 的内部节点位于 refit_order[refit_levels[h], refit_levels[h + 1])
+    uint32_t depth = 0;                                   // 根到最深叶子的边数，扁平化与加载缓存时记录，不超过 bvh_max_depth
+
+    LinearBVH() {}
+
+    /// @brief 从 HittableList 构建扁平化 BVH
+    /// @param time0 快门开启时间
+    /// @param time1 快门关闭时间
+    /// @param options 构建参数 (叶子大小、分桶数量、代价系数)
+    LinearBVH(const HittableList& list, double time0, double time1, const bvh_build_options& options = bvh_build_options())
+        : LinearBVH(list.objects, time0, time1, options) {}
+
+    /// @brief 构建扁平化 BVH；设置了 options.cache_directory 时优先加载缓存，未命中则构建并写入缓存
+    LinearBVH(const std::vector<std::shared_ptr<Hittable>>& objects, double time0, double time1,
+        const bvh_build_options& options = bvh_build_options()) {
+        if (options.cache_directory.empty()) {
+            init(objects, build_bvh(objects, 0, objects.size(), time0, time1, options), options.layout);
+            return;
+        }
+
+        uint64_t key = bvh_cache_key(objects, time0, time1, options);
+        std::string path = bvh_cache_path(options.cache_directory, key);
+        if (load_cache(path, key, objects)) return;
+
+        bvh_build_tree tree = build_bvh(objects, 0, objects.size(), time0, time1, options);
+        init(objects, tree, options.layout);
+        save_cache(path, key, tree);
+    }
+
+    /// @brief 把与布局无关的构建树按 layout 指定的顺序写入连续的节点数组
+    LinearBVH(const std::vector<std::shared_ptr<Hittable>>& objects, const bvh_build_tree& tree,
+        bvh_layout layout = bvh_layout::depth_first) {
+        init(objects, tree, layout);
+    }
+
+    /// @brief 是否从缓存文件加载 (节点直接引用映射内存)
+    bool is_cached() const { return nodes.is_mapped(); }
+
+    virtual bool is_hit(const ray& r, hit& record, double t_min, double t_max) const override {
+        return deferred_hit(r, record, t_min, t_max);
+    }
+
+    virtual bool intersect(const ray& r, double t_min, double t_max, hit_candidate& candidate) const override {
+        if (nodes.empty()) return false;
+
+        vec3 inv_dir{1.0 / r.dir.x, 1.0 / r.dir.y, 1.0 / r.dir.z};
+        int dir_is_neg[3] = {inv_dir.x < 0, inv_dir.y < 0, inv_dir.z < 0};
+        bool hit_anything = false;
+        double closest_so_far = t_max;
+
+        traverse_bvh(nodes.data(), dir_is_neg,
+            [&](const linear_bvh_node& node) {
+                return node_slab_test(node, r, inv_dir, dir_is_neg, t_min, closest_so_far);
+            },
+            [&](const linear_bvh_node& node) {
+                RAGINE_BVH_COUNT(primitive_tests, node.count);
+                for (uint32_t i = 0; i < node.count; i++) {
+                    if (primitives[node.offset + i]->intersect(r, t_min, closest_so_far, candidate)) {
+                        hit_anything = true;
+                        closest_so_far = candidate.time;
+                    }
+                }
+                return false;
+            });
+
+        return hit_anything;
+    }
+
+    /// @brief 开始一次无栈遍历
+    bvh_stackless_state stackless_begin(double t_max) const {
+        bvh_stackless_state state;
+        state.closest = t_max;
+        state.finished = nodes.empty();
+        return state;
+    }
+
+    /// @brief 继续无栈遍历，最多做 max_steps 步 (每步处理一个节点)
+    /// 用父节点指针回溯代替栈：从近端子节点返回时转向兄弟节点，从远端子节点返回时继续向上，
+    /// 访问顺序与 is_hit 相同 (近端优先)，代价是回溯时要多经过一次内部节点 (不做包围盒测试)
+    /// @param candidate 同一条光线的各次调用需传入同一个 candidate，遍历结束时若 state.hit_anything 则保存最近交点，
+    /// 交点属性由 Hittable::finalize_candidate 计算
+    /// @return 遍历是否已经结束
+    bool stackless_resume(bvh_stackless_state& state, const ray& r, hit_candidate& candidate, double t_min,
+        int max_steps = std::numeric_limits<int>::max()) const {
+        vec3 inv_dir{1.0 / r.dir.x, 1.0 / r.dir.y, 1.0 / r.dir.z};
+        int dir_is_neg[3] = {inv_dir.x < 0, inv_dir.y < 0, inv_dir.z < 0};
+        uint32_t current = state.current;
+        bvh_traversal_from from = state.from;
+
+        for (int step = 0; step < max_steps && !state.finished; step++) {
+            const linear_bvh_node& node = nodes[current];
+            bool descend = false;
+
+            if (from != bvh_traversal_from::child) {
+                RAGINE_BVH_COUNT(node_visits, 1);
+                if (node_slab_test(node, r, inv_dir, dir_is_neg, t_min, state.closest)) {
+                    if (node.count > 0) {
+                        RAGINE_BVH_COUNT(primitive_tests, node.count);
+                        for (uint32_t i = 0; i < node.count; i++) {
+                            if (primitives[node.offset + i]->intersect(r, t_min, state.closest, candidate)) {
+                                state.hit_anything = true;
+                                state.closest = candidate.time;
+                            }
+                        }
+                    } else {
+                        descend = true;
+                    }
+                }
+            }
+
+            if (descend) {
+                current = node.offset + dir_is_neg[node.axis];
+                from = bvh_traversal_from::parent;
+                RAGINE_PREFETCH(&nodes[sibling(current)]);
+            } else if (current == 0) {
+                state.finished = true;
+            } else {
+                // current 所在子树已处理完毕：它是近端子节点则转向兄弟节点，否则回到父节点
+                uint32_t parent = parents[(current - 1) / 2];
+                const linear_bvh_node& parent_node = nodes[parent];
+                if (current == parent_node.offset + dir_is_neg[parent_node.axis]) {
+                    current = sibling(current);
+                    from = bvh_traversal_from::sibling;
+                } else {
+                    current = parent;
+                    from = bvh_traversal_from::child;
+                }
+            }
+        }
+
+        state.current = current;
+        state.from = from;
+        return state.finished;
+    }
+
+    /// @brief 结果与 is_hit 相同，但使用无栈遍历
+    bool is_hit_stackless(const ray& r, hit& record, double t_min, double t_max) const {
+        bvh_stackless_state state = stackless_begin(t_max);
+        hit_candidate candidate;
+        stackless_resume(state, r, candidate, t_min);
+        if (state.hit_anything) finalize_candidate(r, candidate, record);
+        return state.hit_anything;
+    }
+
+    /// @brief 遍历顺序与 is_hit 相同，但第一个交点出现时立即返回
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        if (nodes.empty()) return false;
+
+        vec3 inv_dir{1.0 / r.dir.x, 1.0 / r.dir.y, 1.0 / r.dir.z};
+        int dir_is_neg[3] = {inv_dir.x < 0, inv_dir.y < 0, inv_dir.z < 0};
+
+        return traverse_bvh(nodes.data(), dir_is_neg,
+            [&](const linear_bvh_node& node) {
+                return node_slab_test(node, r, inv_dir, dir_is_neg, t_min, t_max);
+            },
+            [&](const linear_bvh_node& node) {
+                for (uint32_t i = 0; i < node.count; i++) {
+                    RAGINE_BVH_COUNT(primitive_tests, 1);
+                    if (primitives[node.offset + i]->is_occluded(r, t_min, t_max)) return true;
+                }
+                return false;
+            });
+    }
+
+    virtual bool bounding_box(double t0, double t1, aabb& output_box) const override {
+        if (nodes.empty()) return false;
+        output_box = box;
+        return true;
+    }
+
+    virtual vec3 get_position() const override {
+        return {0.0, 0.0, 0.0};
+    }
+
+    /// @brief 统计节点数量、深度与期望遍历代价 (SAH cost)
+    bvh_stats stats(const bvh_build_options& options = bvh_build_options()) const {
+        bvh_stats result;
+        if (nodes.empty()) return result;
+
+        double root_area = node_bounds(nodes[0]).surface_area();
+        std::vector<std::pair<uint32_t, size_t>> pending{{0, 1}};
+        while (!pending.empty()) {
+            auto [index, depth] = pending.back();
+            pending.pop_back();
+
+            const linear_bvh_node& node = nodes[index];
+            double weight = root_area > 0.0 ? node_bounds(node).surface_area() / root_area : 1.0;
+            result.node_count++;
+            result.max_depth = std::max(result.max_depth, depth);
+
+            if (node.count > 0) {
+                result.leaf_count++;
+                result.sah_cost += options.intersect_cost * weight * node.count;
+            } else {
+                result.sah_cost += options.traversal_cost * weight;
+                pending.push_back({node.offset, depth + 1});
+                pending.push_back({node.offset + 1, depth + 1});
+            }
+        }
+        return result;
+    }
+
+    /// @brief 物体移动或缩放后，不改变树结构，自底向上重新计算所有节点的包围盒
+    /// @param time0 快门开启时间
+    /// @param time1 快门关闭时间
+    /// @return 重新拟合后的 SAH 代价与构建时的比值，明显大于 1 (比如超过 1.5) 说明树的质量已经下降，值得完全重建
+    double refit(double time0 = 0.0, double time1 = 0.0) {
+        if (nodes.empty()) return 1.0;
+
+        // 叶子的包围盒需要查询物体，开销最大，彼此独立可以并行计算
+        long long count = (long long)nodes.size();
+        #pragma omp parallel for schedule(dynamic, 1024) if (count >= 8192)
+        for (long long i = 0; i < count; i++) {
+            if (nodes[i].count > 0) refit_node((uint32_t)i, time0, time1);
+        }
+
+        // 同一高度的内部节点只依赖更低的层，逐层并行合并子节点的包围盒
+        for (size_t level = 1; level + 1 < refit_levels.size(); level++) {
+            long long begin = refit_levels[level], end = refit_levels[level + 1];
+            #pragma omp parallel for schedule(static) if (end - begin >= 4096)
+            for (long long i = begin; i < end; i++) refit_node(refit_order[i], time0, time1);
+        }
+
+        box = node_bounds(nodes[0]);
+        return build_sah_cost > 0.0 ? stats().sah_cost / build_sah_cost : 1.0;
+    }
+
+private:
+    void init(const std::vector<std::shared_ptr<Hittable>>& objects, const bvh_build_tree& tree, bvh_layout layout) {
+        if (tree.empty()) return;
+
+        // 由外部构建的树可能超出遍历栈的容量，按默认参数重新构建 (build_bvh 会限制深度)
+        if (bvh_tree_depth(tree) > bvh_max_depth) {
+            std::cerr << "WARNING: BVH is deeper than " << bvh_max_depth << " levels, rebuilding it.\n";
+            bvh_build_options options;
+            options.layout = layout;
+            init(objects, build_bvh(tree.prims, options), layout);
+            return;
+        }
+
+        flatten(tree, layout);
+
+        // 叶子直接引用构建树中 prims 的区间，物体数组按 prims 顺序排列即可
+        long long count = (long long)tree.prims.size();
+        primitives.resize(count);
+        #pragma omp parallel for schedule(static) if (count >= 65536)
+        for (long long i = 0; i < count; i++) primitives[i] = objects[tree.prims[i].index];
+
+        build_sah_cost = stats().sah_cost;
+        link_parents();
+        group_refit_levels();
+    }
+
+    /// @brief 兄弟节点成对存放，根节点之后第 k 对占据下标 2k+1 与 2k+2
+    static uint32_t sibling(uint32_t index) {
+        return (index & 1) ? index + 1 : index - 1;
+    }
+
+    /// @brief 由子节点下标反推每对兄弟节点的父节点
+    void link_parents() {
+        parents.assign(nodes.size() / 2, 0);
+        for (uint32_t i = 0; i < (uint32_t)nodes.size(); i++) {
+            if (nodes[i].count == 0) parents[(nodes[i].offset - 1) / 2] = i;
+        }
+    }
+
+    /// @brief 按高度对内部节点分组 (计数排序)，供 refit 逐层并行；根节点的高度即为树的深度
+    void group_refit_levels() {
+        // 任何布局中子节点的下标都大于父节点，逆序遍历即为自底向上
+        std::vector<uint32_t> height(nodes.size(), 0);
+        uint32_t max_height = 0;
+        for (size_t i = nodes.size(); i-- > 0; ) {
+            if (nodes[i].count > 0) continue;
+            height[i] = 1 + std::max(height[nodes[i].offset], height[nodes[i].offset + 1]);
+            max_height = std::max(max_height, height[i]);
+        }
+
+        depth = max_height;
+        assert(depth <= bvh_max_depth);
+
+        refit_levels.assign(max_height + 2, 0);
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (nodes[i].count == 0) refit_levels[height[i] + 1]++;
+        }
+        for (size_t h = 1; h < refit_levels.size(); h++) refit_levels[h] += refit_levels[h - 1];
+
+        refit_order.resize(refit_levels.back());
+        std::vector<uint32_t> cursor(refit_levels.begin(), refit_levels.end() - 1);
+        for (uint32_t i = 0; i < (uint32_t)nodes.size(); i++) {
+            if (nodes[i].count == 0) refit_order[cursor[height[i]]++] = i;
+        }
+    }
+
+    /// @brief 映射缓存文件，节点直接引用映射内存，只需按保存的下标重新排列物体指针
+    /// @return 文件不存在、与 key 不匹配或内容不完整时返回 false
+    bool load_cache(const std::string& path, uint64_t key, const std::vector<std::shared_ptr<Hittable>>& objects) {
+        auto file = mapped_file::open(path);
+        if (!file || file->size() < sizeof(bvh_cache_header)) return false;
+
+        bvh_cache_header header;
+        std::memcpy(&header, file->data(), sizeof(header));
+        if (std::memcmp(header.magic, bvh_cache_magic, sizeof(header.magic)) != 0 || header.key != key ||
+            header.node_size != sizeof(linear_bvh_node) || header.primitive_count != objects.size() || header.node_count == 0) {
+            return false;
+        }
+
+        size_t node_bytes = header.node_count * sizeof(linear_bvh_node);
+        if (file->size() != sizeof(header) + node_bytes + header.primitive_count * sizeof(uint32_t)) return false;
+
+        const linear_bvh_node* cached_nodes = reinterpret_cast<const linear_bvh_node*>(file->data() + sizeof(header));
+        if (!valid_nodes(cached_nodes, header.node_count, header.primitive_count)) {
+            std::cerr << "WARNING: BVH cache " << path << " has inconsistent nodes, rebuilding.\n";
+            return false;
+        }
+
+        const uint32_t* indices = reinterpret_cast<const uint32_t*>(file->data() + sizeof(header) + node_bytes);
+        long long count = (long long)header.primitive_count;
+        bool valid = true;
+        primitives.resize(count);
+        #pragma omp parallel for schedule(static) reduction(&& : valid) if (count >= 65536)
+        for (long long i = 0; i < count; i++) {
+            if (indices[i] < objects.size()) primitives[i] = objects[indices[i]];
+            else valid = false;
+        }
+        if (!valid) {
+            primitives.clear();
+            return false;
+        }
+
+        nodes.map(file, sizeof(header), header.node_count);
+        box = aabb(vec3{header.box_min[0], header.box_min[1], header.box_min[2]},
+                   vec3{header.box_max[0], header.box_max[1], header.box_max[2]});
+        build_sah_cost = header.build_sah_cost;
+        link_parents();
+        group_refit_levels();
+        return true;
+    }
+
+    /// @brief 检查缓存中的节点能否安全遍历：子节点成对位于父节点之后且只被引用一次，叶子区间不越界，划分轴合法，
+    /// 深度不超过遍历栈的容量；文件损坏或被改写时这些下标会直接用于数组访问，必须在映射之前逐个检查
+    static bool valid_nodes(const linear_bvh_node* cached, uint64_t node_count, uint64_t primitive_count) {
+        if (node_count % 2 == 0 || node_count > UINT32_MAX) return false;
+
+        std::vector<uint8_t> referenced(node_count / 2, 0);
+        std::vector<uint8_t> node_depth(node_count, 0);
+        for (uint64_t i = 0; i < node_count; i++) {
+            const linear_bvh_node& node = cached[i];
+            if (node.count > 0) {
+                if ((uint64_t)node.offset + node.count > primitive_count) return false;
+                continue;
+            }
+            // 兄弟节点对从奇数下标开始，且在父节点之后，保证整棵树无环
+            if (node.axis > 2 || node.offset % 2 == 0 || node.offset <= i || (uint64_t)node.offset + 1 >= node_count) return false;
+            uint8_t& seen = referenced[(node.offset - 1) / 2];
+            if (seen) return false;
+            seen = 1;
+
+            // 父节点总在子节点之前，顺序扫描即可得到每个节点的深度
+            if (node_depth[i] >= bvh_max_depth) return false;
+            node_depth[node.offset] = node_depth[node.offset + 1] = node_depth[i] + 1;
+        }
+        return std::all_of(referenced.begin(), referenced.end(), [](uint8_t seen) { return seen != 0; });
+    }
+
+    /// @brief 写入缓存文件：先写临时文件再重命名，多个进程同时写入同一场景时不会读到半个文件
+    void save_cache(const std::string& path, uint64_t key, const bvh_build_tree& tree) const {
+        if (nodes.empty()) return;
+
+        bvh_cache_header header;
+        std::memcpy(header.magic, bvh_cache_magic, sizeof(header.magic));
+        header.key = key;
+        header.node_size = sizeof(linear_bvh_node);
+        header.node_count = nodes.size();
+        header.primitive_count = tree.prims.size();
+        header.build_sah_cost = build_sah_cost;
+        for (int axis = 0; axis < 3; axis++) {
+            header.box_min[axis] = box.minimum[axis];
+            header.box_max[axis] = box.maximum[axis];
+        }
+
+        std::vector<uint32_t> indices(tree.prims.size());
+        for (size_t i = 0; i < tree.prims.size(); i++) indices[i] = (uint32_t)tree.prims[i].index;
+
+        std::string temp_path = path + ".tmp" + std::to_string(std::random_device{}());
+        {
+            std::ofstream out(temp_path, std::ios::binary);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(linear_bvh_node));
+            out.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint32_t));
+            if (!out) {
+                std::cerr << "WARNING: Could not write BVH cache file '" << temp_path << "'.\n";
+                std::remove(temp_path.c_str());
+                return;
+            }
+        }
+        if (std::rename(temp_path.c_str(), path.c_str()) != 0) std::remove(temp_path.c_str());
+    }
+
+    void refit_node(uint32_t index, double time0, double time1) {
+        linear_bvh_node& node = nodes[index];
+        if (node.count > 0) {
+            aabb bounds = empty_box();
+            for (uint32_t i = 0; i < node.count; i++) {
+                aabb primitive_box;
+                if (primitives[node.offset + i]->bounding_box(time0, time1, primitive_box))
+                    bounds = surrounding_box(bounds, primitive_box);
+            }
+            set_node_bounds(node, bounds);
+            return;
+        }
+
+        const linear_bvh_node& left = nodes[node.offset];
+        const linear_bvh_node& right = nodes[node.offset + 1];
+        for (int axis = 0; axis < 3; axis++) {
+            node.bounds_min[axis] = std::min(left.bounds_min[axis], right.bounds_min[axis]);
+            node.bounds_max[axis] = std::max(left.bounds_max[axis], right.bounds_max[axis]);
+        }
+    }
+
+    /// @brief 一对待写入的兄弟节点：parent 为它们的父节点在 nodes 中的下标，build_parent 为父节点在构建树中的下标
+    struct sibling_pair { uint32_t parent; uint32_t build_parent; };
+
+    /// @brief 自底向上计算构建树中每个节点的包围盒与高度 (叶子高度为 0)
+    static aabb build_bounds(const bvh_build_tree& tree, uint32_t index, std::vector<aabb>& bounds, std::vector<uint32_t>& height) {
+        const bvh_build_node& node = tree.nodes[index];
+        if (node.count > 0) {
+            bounds[index] = primitive_bounds(tree.prims, node.first, node.first + node.count);
+            height[index] = 0;
+        } else {
+            bounds[index] = surrounding_box(build_bounds(tree, node.child[0], bounds, height), build_bounds(tree, node.child[1], bounds, height));
+            height[index] = 1 + std::max(height[node.child[0]], height[node.child[1]]);
+        }
+        return bounds[index];
+    }
+
+    void write_node(uint32_t index, const bvh_build_tree& tree, uint32_t build_index, const std::vector<aabb>& bounds) {
+        const bvh_build_node& build_node = tree.nodes[build_index];
+        linear_bvh_node& node = nodes[index];
+        node.offset = build_node.first;
+        node.count = build_node.count;
+        node.axis = build_node.count > 0 ? 0 : build_node.axis;
+        node.pad = 0;
+        set_node_bounds(node, bounds[build_index]);
+    }
+
+    /// @brief 在数组末尾连续写入一对兄弟节点，并让父节点指向它们
+    uint32_t emit_pair(const sibling_pair& pair, const bvh_build_tree& tree, const std::vector<aabb>& bounds) {
+        const bvh_build_node& build_node = tree.nodes[pair.build_parent];
+        uint32_t index = (uint32_t)nodes.size();
+        nodes.emplace_back();
+        nodes.emplace_back();
+        nodes[pair.parent].offset = index;
+        write_node(index, tree, build_node.child[0], bounds);
+        write_node(index + 1, tree, build_node.child[1], bounds);
+        return index;
+    }
+
+    /// @brief index 处刚写入的一对兄弟节点中，内部节点的子节点对
+    static void child_pairs(uint32_t index, const bvh_build_tree& tree, uint32_t build_parent, std::vector<sibling_pair>& out) {
+        for (int k = 0; k < 2; k++) {
+            uint32_t child = tree.nodes[build_parent].child[k];
+            if (tree.nodes[child].count == 0) out.push_back({index + (uint32_t)k, child});
+        }
+    }
+
+    void layout_depth_first(const sibling_pair& pair, const bvh_build_tree& tree, const std::vector<aabb>& bounds) {
+        uint32_t index = emit_pair(pair, tree, bounds);
+        for (int k = 0; k < 2; k++) {
+            uint32_t child = tree.nodes[pair.build_parent].child[k];
+            if (tree.nodes[child].count == 0) layout_depth_first({index + (uint32_t)k, child}, tree, bounds);
+        }
+    }
+
+    void layout_breadth_first(const sibling_pair& root, const bvh_build_tree& tree, const std::vector<aabb>& bounds) {
+        std::vector<sibling_pair> queue{root};
+        for (size_t head = 0; head < queue.size(); head++) {
+            sibling_pair pair = queue[head];
+            child_pairs(emit_pair(pair, tree, bounds), tree, pair.build_parent, queue);
+        }
+    }
+
+    /// @brief van Emde Boas 布局：把 height 层的子树切成上下两半，先递归写入上半部分，再依次递归写入下半部分的每棵子树
+    /// 任意大小的缓存块都能装下若干层完整的子树，与缓存行和页的大小无关
+    /// @param frontier 输出恰好位于 height 层之下、尚未写入的兄弟节点对
+    void layout_van_emde_boas(const sibling_pair& pair, uint32_t height, const bvh_build_tree& tree,
+        const std::vector<aabb>& bounds, std::vector<sibling_pair>& frontier) {
+        if (height <= 1) {
+            child_pairs(emit_pair(pair, tree, bounds), tree, pair.build_parent, frontier);
+            return;
+        }
+
+        uint32_t top = height / 2;
+        std::vector<sibling_pair> middle;
+        layout_van_emde_boas(pair, top, tree, bounds, middle);
+        for (const sibling_pair& bottom : middle) layout_van_emde_boas(bottom, height - top, tree, bounds, frontier);
+    }
+
+    /// @brief 把构建树写入节点数组，根节点位于下标 0，其余节点成对写入，顺序由 layout 决定
+    void flatten(const bvh_build_tree& tree, bvh_layout layout) {
+        std::vector<aabb> bounds(tree.nodes.size());
+        std::vector<uint32_t> height(tree.nodes.size());
+        box = build_bounds(tree, 0, bounds, height);
+
+        nodes.reserve(tree.nodes.size());
+        nodes.emplace_back();
+        write_node(0, tree, 0, bounds);
+        if (tree.nodes[0].count > 0) return;
+
+        sibling_pair root{0, 0};
+        switch (layout) {
+        case bvh_layout::breadth_first:
+            layout_breadth_first(root, tree, bounds);
+            break;
+        case bvh_layout::van_emde_boas: {
+            std::vector<sibling_pair> frontier;
+            layout_van_emde_boas(root, height[0], tree, bounds, frontier);
+            break;
+        }
+        default:
+            layout_depth_first(root, tree, bounds);
+            break;
+        }
+    }
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "ragine.h"
+#include <cstdint>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/// @brief 物体中心点的 Morton 码 (63 位，每轴 21 位) 与物体引用下标
+struct morton_primitive {
+    uint64_t code;
+    uint32_t index;
+};
+
+/// @brief 把 21 位整数的每一位之间插入两个 0
+inline uint64_t expand_bits_21(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffull;
+    v = (v | v << 16) & 0x1f0000ff0000ffull;
+    v = (v | v << 8) & 0x100f00f00f00f00full;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+    v = (v | v << 2) & 0x1249249249249249ull;
+    return v;
+}
+
+/// @brief 计算 [0, 1]^3 内一点的 Morton 码，x 位于最高位，其次是 y、z
+inline uint64_t morton_code(const vec3& unit_point) {
+    const double scale = (double)((1 << 21) - 1);
+    uint64_t x = (uint64_t)std::min(std::max(unit_point.x * scale, 0.0), scale);
+    uint64_t y = (uint64_t)std::min(std::max(unit_point.y * scale, 0.0), scale);
+    uint64_t z = (uint64_t)std::min(std::max(unit_point.z * scale, 0.0), scale);
+    return (expand_bits_21(x) << 2) | (expand_bits_21(y) << 1) | expand_bits_21(z);
+}
+
+/// @brief Morton 码第 bit 位对应的坐标轴
+inline int morton_bit_axis(int bit) {
+    return 2 - bit % 3;
+}
+
+/// @brief 并行 LSD 基数排序 (每趟 8 位)，所有元素在某一趟上取值相同时跳过该趟
+/// @param parallel_threshold 元素数量超过该值时使用多线程
+inline void radix_sort_morton(std::vector<morton_primitive>& items, size_t parallel_threshold = 4096) {
+    const int digit_bits = 8;
+    const int buckets = 1 << digit_bits;
+    size_t n = items.size();
+    if (n < 2) return;
+
+    std::vector<morton_primitive> buffer(n);
+    morton_primitive* src = items.data();
+    morton_primitive* dst = buffer.data();
+
+    int thread_count = 1;
+#ifdef _OPENMP
+    if (n >= parallel_threshold) thread_count = omp_get_max_threads();
+#endif
+    std::vector<size_t> histogram((size_t)thread_count * buckets);
+    bool skip_pass = false;
+
+    #pragma omp parallel num_threads(thread_count) if (thread_count > 1)
+    {
+        int thread = 0;
+        int threads = 1;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+        threads = omp_get_num_threads();
+#endif
+        size_t begin = n * thread / threads;
+        size_t end = n * (thread + 1) / threads;
+
+        for (int shift = 0; shift < 64; shift += digit_bits) {
+            size_t* local = histogram.data() + (size_t)thread * buckets;
+            std::fill(local, local + buckets, 0);
+            for (size_t i = begin; i < end; i++) local[(src[i].code >> shift) & (buckets - 1)]++;
+
+            #pragma omp barrier
+            #pragma omp single
+            {
+                // 按 (桶, 线程) 的顺序求前缀和，得到每个线程在每个桶中的写入起点
+                size_t sum = 0;
+                skip_pass = false;
+                for (int b = 0; b < buckets; b++) {
+                    size_t bucket_total = 0;
+                    for (int t = 0; t < threads; t++) {
+                        size_t c = histogram[(size_t)t * buckets + b];
+                        histogram[(size_t)t * buckets + b] = sum;
+                        sum += c;
+                        bucket_total += c;
+                    }
+                    if (bucket_total == n) skip_pass = true;
+                }
+            }
+
+            if (!skip_pass) {
+                for (size_t i = begin; i < end; i++) dst[local[(src[i].code >> shift) & (buckets - 1)]++] = src[i];
+
+                #pragma omp barrier
+                #pragma omp single
+                std::swap(src, dst);
+            }
+        }
+    }
+
+    if (src != items.data()) std::copy(src, src + n, items.data());
+}
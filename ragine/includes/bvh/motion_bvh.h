@@ -0,0 +1,228 @@
+#pragma once
+
+#include "ragine.h"
+#include "../ray_tracing/object.h"
+#include "bvh_build.h"
+#include "linear_bvh.h"
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+/// @brief 运动 BVH 节点 (56 字节)：分别记录快门开启与关闭时刻的包围盒，遍历时按光线时刻线性插值
+/// 兄弟节点相邻存放，内部节点的两个子节点下标为 offset 与 offset + 1
+struct motion_bvh_node {
+    float bounds_min[2][3];     // [0] 为 time0 时刻，[1] 为 time1 时刻
+    float bounds_max[2][3];
+    uint32_t offset;    // 叶子节点: 第一个物体在 primitives 中的下标; 内部节点: 第一个子节点下标
+    uint16_t count;     // 叶子节点的物体数量，0 表示内部节点
+    uint8_t axis;       // 内部节点的划分轴
+    uint8_t pad;
+};
+
+static_assert(sizeof(motion_bvh_node) == 56, "motion_bvh_node should stay 56 bytes");
+
+/// @brief 插值包围盒的 slab 测试，s 为光线时刻在快门区间内的比例 [0, 1]
+/// 物体匀速运动时，两端包围盒的插值总能包住该时刻的所有物体，比覆盖整个快门的包围盒紧得多
+inline bool motion_slab_test(const motion_bvh_node& node, const ray& r, const vec3& inv_dir, const int dir_is_neg[3],
+    double s, double t_min, double t_max) {
+    for (int axis = 0; axis < 3; axis++) {
+        double lo = node.bounds_min[0][axis] + s * ((double)node.bounds_min[1][axis] - node.bounds_min[0][axis]);
+        double hi = node.bounds_max[0][axis] + s * ((double)node.bounds_max[1][axis] - node.bounds_max[0][axis]);
+        double t0 = ((dir_is_neg[axis] ? hi : lo) - r.origin[axis]) * inv_dir[axis];
+        double t1 = ((dir_is_neg[axis] ? lo : hi) - r.origin[axis]) * inv_dir[axis];
+
+        t_min = t0 > t_min ? t0 : t_min;
+        t_max = t1 < t_max ? t1 : t_max;
+
+        if (t_min > t_max) return false;
+    }
+    return true;
+}
+
+/// @brief 运动模糊用的 BVH (MSBVH)：树按覆盖整个快门的包围盒构建，每个节点再记录两端时刻的包围盒
+/// 光线按自身时刻在两端包围盒之间插值，运动物体不会像静态 BVH 那样让沿途的节点都变得很大
+/// 光线时刻应位于 [time0, time1] 内，超出时按最近的一端处理
+class MotionBVH : public Hittable {
+public:
+    std::vector<motion_bvh_node> nodes;
+    std::vector<std::shared_ptr<Hittable>> primitives;
+    double time0 = 0.0, time1 = 0.0;
+    aabb box;   // 覆盖整个快门的包围盒
+
+    MotionBVH() {}
+
+    /// @brief 从 HittableList 构建运动 BVH
+    /// @param t0 快门开启时间
+    /// @param t1 快门关闭时间
+    MotionBVH(const HittableList& list, double t0, double t1, const bvh_build_options& options = bvh_build_options())
+        : MotionBVH(list.objects, t0, t1, options) {}
+
+    MotionBVH(const std::vector<std::shared_ptr<Hittable>>& objects, double t0, double t1,
+        const bvh_build_options& options = bvh_build_options()) : time0(t0), time1(t1) {
+        bvh_build_tree tree = build_bvh(objects, 0, objects.size(), t0, t1, options);
+        if (tree.empty()) return;
+
+        long long count = (long long)tree.prims.size();
+        primitives.resize(count);
+        std::vector<aabb> start_boxes(count), end_boxes(count);
+        #pragma omp parallel for schedule(static) if (count >= (long long)options.parallel_threshold)
+        for (long long i = 0; i < count; i++) {
+            primitives[i] = objects[tree.prims[i].index];
+            primitives[i]->bounding_box(t0, t0, start_boxes[i]);
+            primitives[i]->bounding_box(t1, t1, end_boxes[i]);
+        }
+
+        nodes.reserve(tree.nodes.size());
+        nodes.emplace_back();
+        emit(tree, 0, 0, start_boxes, end_boxes);
+        box = primitive_bounds(tree.prims, 0, tree.prims.size());
+    }
+
+    virtual bool is_hit(const ray& r, hit& record, double t_min, double t_max) const override {
+        return deferred_hit(r, record, t_min, t_max);
+    }
+
+    virtual bool intersect(const ray& r, double t_min, double t_max, hit_candidate& candidate) const override {
+        if (nodes.empty()) return false;
+
+        double s = shutter_fraction(r.time);
+        vec3 inv_dir{1.0 / r.dir.x, 1.0 / r.dir.y, 1.0 / r.dir.z};
+        int dir_is_neg[3] = {inv_dir.x < 0, inv_dir.y < 0, inv_dir.z < 0};
+
+        bool hit_anything = false;
+        double closest_so_far = t_max;
+
+        traverse_bvh(nodes.data(), dir_is_neg,
+            [&](const motion_bvh_node& node) {
+                return motion_slab_test(node, r, inv_dir, dir_is_neg, s, t_min, closest_so_far);
+            },
+            [&](const motion_bvh_node& node) {
+                RAGINE_BVH_COUNT(primitive_tests, node.count);
+                for (uint32_t i = 0; i < node.count; i++) {
+                    if (primitives[node.offset + i]->intersect(r, t_min, closest_so_far, candidate)) {
+                        hit_anything = true;
+                        closest_so_far = candidate.time;
+                    }
+                }
+                return false;
+            });
+
+        return hit_anything;
+    }
+
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        if (nodes.empty()) return false;
+
+        double s = shutter_fraction(r.time);
+        vec3 inv_dir{1.0 / r.dir.x, 1.0 / r.dir.y, 1.0 / r.dir.z};
+        int dir_is_neg[3] = {inv_dir.x < 0, inv_dir.y < 0, inv_dir.z < 0};
+
+        return traverse_bvh(nodes.data(), dir_is_neg,
+            [&](const motion_bvh_node& node) {
+                return motion_slab_test(node, r, inv_dir, dir_is_neg, s, t_min, t_max);
+            },
+            [&](const motion_bvh_node& node) {
+                for (uint32_t i = 0; i < node.count; i++) {
+                    RAGINE_BVH_COUNT(primitive_tests, 1);
+                    if (primitives[node.offset + i]->is_occluded(r, t_min, t_max)) return true;
+                }
+                return false;
+            });
+    }
+
+    virtual bool bounding_box(double t0, double t1, aabb& output_box) const override {
+        if (nodes.empty()) return false;
+        output_box = box;
+        return true;
+    }
+
+    virtual vec3 get_position() const override {
+        return {0.0, 0.0, 0.0};
+    }
+
+    /// @brief 节点在快门区间内比例 s 处的包围盒
+    static aabb node_bounds_at(const motion_bvh_node& node, double s) {
+        vec3 lo, hi;
+        for (int axis = 0; axis < 3; axis++) {
+            lo[axis] = node.bounds_min[0][axis] + s * ((double)node.bounds_min[1][axis] - node.bounds_min[0][axis]);
+            hi[axis] = node.bounds_max[0][axis] + s * ((double)node.bounds_max[1][axis] - node.bounds_max[0][axis]);
+        }
+        return aabb(lo, hi);
+    }
+
+    /// @brief 统计节点数量、深度与期望遍历代价，代价按快门中点时刻的包围盒计算
+    bvh_stats stats(const bvh_build_options& options = bvh_build_options()) const {
+        bvh_stats result;
+        if (nodes.empty()) return result;
+
+        double root_area = node_bounds_at(nodes[0], 0.5).surface_area();
+        std::vector<std::pair<uint32_t, size_t>> pending{{0, 1}};
+        while (!pending.empty()) {
+            auto [index, depth] = pending.back();
+            pending.pop_back();
+
+            const motion_bvh_node& node = nodes[index];
+            double weight = root_area > 0.0 ? node_bounds_at(node, 0.5).surface_area() / root_area : 1.0;
+            result.node_count++;
+            result.max_depth = std::max(result.max_depth, depth);
+
+            if (node.count > 0) {
+                result.leaf_count++;
+                result.sah_cost += options.intersect_cost * weight * node.count;
+            } else {
+                result.sah_cost += options.traversal_cost * weight;
+                pending.push_back({node.offset, depth + 1});
+                pending.push_back({node.offset + 1, depth + 1});
+            }
+        }
+        return result;
+    }
+
+private:
+    double shutter_fraction(double time) const {
+        if (time1 <= time0) return 0.0;
+        return std::clamp((time - time0) / (time1 - time0), 0.0, 1.0);
+    }
+
+    static void set_bounds(motion_bvh_node& node, int end, const aabb& bounds) {
+        for (int axis = 0; axis < 3; axis++) {
+            node.bounds_min[end][axis] = round_down_float(bounds.minimum[axis]);
+            node.bounds_max[end][axis] = round_up_float(bounds.maximum[axis]);
+        }
+    }
+
+    /// @brief 深度优先写出构建树中 build_index 对应的子树，兄弟节点成对追加在数组末尾
+    /// @return 子树在 time0 与 time1 时刻的包围盒
+    std::pair<aabb, aabb> emit(const bvh_build_tree& tree, uint32_t build_index, uint32_t index,
+        const std::vector<aabb>& start_boxes, const std::vector<aabb>& end_boxes) {
+        const bvh_build_node& build_node = tree.nodes[build_index];
+        std::pair<aabb, aabb> bounds{empty_box(), empty_box()};
+
+        if (build_node.count > 0) {
+            for (uint32_t i = build_node.first; i < build_node.first + build_node.count; i++) {
+                bounds.first = surrounding_box(bounds.first, start_boxes[i]);
+                bounds.second = surrounding_box(bounds.second, end_boxes[i]);
+            }
+            nodes[index].offset = build_node.first;
+            nodes[index].count = build_node.count;
+            nodes[index].axis = 0;
+        } else {
+            uint32_t children = (uint32_t)nodes.size();
+            nodes.emplace_back();
+            nodes.emplace_back();
+            for (int c = 0; c < 2; c++) {
+                std::pair<aabb, aabb> child = emit(tree, build_node.child[c], children + c, start_boxes, end_boxes);
+                bounds.first = surrounding_box(bounds.first, child.first);
+                bounds.second = surrounding_box(bounds.second, child.second);
+            }
+            nodes[index].offset = children;
+            nodes[index].count = 0;
+            nodes[index].axis = build_node.axis;
+        }
+
+        nodes[index].pad = 0;
+        set_bounds(nodes[index], 0, bounds.first);
+        set_bounds(nodes[index], 1, bounds.second);
+        return bounds;
+    }
+};
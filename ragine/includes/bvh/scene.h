@@ -0,0 +1,76 @@
+#pragma once
+
+#include "ragine.h"
+#include "../ray_tracing/object.h"
+#include "linear_bvh.h"
+
+/// @brief 场景加速结构：有包围盒的物体放进 BVH，无限物体 (比如 Plane) 单独逐个测试
+/// 使用者可以把所有物体放进同一个 HittableList，不必再手动把可以加速的物体挑出来
+class Scene : public Hittable {
+public:
+    std::shared_ptr<LinearBVH> bounded;
+    std::vector<std::shared_ptr<Hittable>> unbounded;
+
+    Scene() {}
+
+    /// @brief 从 HittableList 构建场景，按 bounding_box 的返回值划分物体
+    /// @param time0 快门开启时间
+    /// @param time1 快门关闭时间
+    /// @param options BVH 构建参数
+    Scene(const HittableList& list, double time0, double time1, const bvh_build_options& options = bvh_build_options()) {
+        std::vector<std::shared_ptr<Hittable>> finite;
+        for (const auto& object : list.objects) {
+            aabb box;
+            if (object->bounding_box(time0, time1, box)) finite.push_back(object);
+            else unbounded.push_back(object);
+        }
+
+        bounded = std::make_shared<LinearBVH>(finite, time0, time1, options);
+    }
+
+    virtual bool is_hit(const ray& r, hit& record, double t_min, double t_max) const override {
+        return deferred_hit(r, record, t_min, t_max);
+    }
+
+    virtual bool intersect(const ray& r, double t_min, double t_max, hit_candidate& candidate) const override {
+        bool hit_anything = false;
+        double closest_so_far = t_max;
+
+        // 无限物体数量很少且求交便宜，先测试它们可以缩短 BVH 遍历的 t_max
+        for (const auto& object : unbounded) {
+            if (object->intersect(r, t_min, closest_so_far, candidate)) {
+                hit_anything = true;
+                closest_so_far = candidate.time;
+            }
+        }
+
+        if (bounded && bounded->intersect(r, t_min, closest_so_far, candidate)) hit_anything = true;
+
+        return hit_anything;
+    }
+
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        for (const auto& object : unbounded) {
+            if (object->is_occluded(r, t_min, t_max)) return true;
+        }
+        return bounded && bounded->is_occluded(r, t_min, t_max);
+    }
+
+    virtual bool bounding_box(double t0, double t1, aabb& output_box) const override {
+        if (!unbounded.empty() || !bounded) return false;
+        return bounded->bounding_box(t0, t1, output_box);
+    }
+
+    virtual vec3 get_position() const override {
+        return {0.0, 0.0, 0.0};
+    }
+
+    int get_size() const {
+        return (int)unbounded.size() + (bounded ? (int)bounded->primitives.size() : 0);
+    }
+
+    /// @brief BVH 部分的结构统计
+    bvh_stats stats(const bvh_build_options& options = bvh_build_options()) const {
+        return bounded ? bounded->stats(options) : bvh_stats();
+    }
+};
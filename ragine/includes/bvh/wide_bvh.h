@@ -0,0 +1,351 @@
+#pragma once
+
+#include "ragine.h"
+#include "linear_bvh.h"
+#include "../components/cpu_dispatch.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <immintrin.h>
+#define RAGINE_WIDE_SSE 1
+#endif
+
+/// @brief 多叉 BVH 节点，Width 个子节点的包围盒以 SoA 形式存放，便于一次 SIMD 指令测试全部子节点
+/// count[i] > 0: 子节点 i 为叶子，child[i] 为第一个物体下标; count[i] == 0: 子节点 i 为内部节点
+/// valid 的第 i 位为 0 表示该槽位为空
+template <int Width>
+struct alignas(32) wide_bvh_node {
+    float bounds_min[3][Width];
+    float bounds_max[3][Width];
+    uint32_t child[Width];
+    uint32_t count[Width];
+    uint32_t valid;
+};
+
+/// @brief 多叉 BVH 遍历栈的容量：每访问一个节点弹出一项、最多压入 width 个子节点；
+/// 折叠时每一层多叉节点至少消耗一层二叉节点，多叉树的深度不超过二叉 LinearBVH 的深度 (不超过 bvh_max_depth)
+constexpr int wide_stack_size(int width) {
+    return bvh_max_depth * (width - 1) + 1;
+}
+
+/// @brief float 精度遍历使用的光线
+/// 起点转换为 float 的误差是绝对误差，远离原点时可以比擦边光线到包围盒的距离还大，因此起点分别向两侧放宽：
+/// 包围盒下界减去 org_min (偏大)、上界减去 org_max (偏小)，相当于把包围盒向外扩大起点误差与 float 运算误差之和
+struct wide_ray {
+    float org_min[3];
+    float org_max[3];
+    float inv_dir[3];
+};
+
+/// @brief 由 double 光线得到 wide_ray
+/// @param box 场景包围盒，用于估计 float 减法与乘法的舍入误差 (与坐标的绝对值成正比)
+inline wide_ray make_wide_ray(const ray& r, const aabb& box) {
+    wide_ray result;
+    for (int axis = 0; axis < 3; axis++) {
+        double origin = r.origin[axis];
+        double extent = std::max(std::fabs(box.minimum[axis]), std::fabs(box.maximum[axis]));
+        // 减法、乘法与方向倒数的舍入各不超过 2^-24 倍的坐标量级，留出 16 倍余量，量化包围盒的解码也在其中
+        double slack = std::ldexp(extent + std::fabs(origin), -20);
+        result.org_min[axis] = round_up_float(origin + slack);
+        result.org_max[axis] = round_down_float(origin - slack);
+        result.inv_dir[axis] = (float)(1.0 / r.dir[axis]);
+    }
+    return result;
+}
+
+/// @brief 对 Width 个子节点的包围盒做 slab 测试
+/// @param wr 放宽了起点的 float 光线
+/// @param t_near 输出每个子节点的进入距离
+/// @return 命中的子节点掩码
+template <int Width>
+inline uint32_t wide_slab_test(const wide_bvh_node<Width>& node, const wide_ray& wr,
+    float t_min, float t_max, float t_near[Width]) {
+    uint32_t mask = 0;
+
+    // 8 叉节点统一交给运行时选择的核心 (slab_test8)，CPU 支持 AVX2 / AVX-512 时一次测试 8 个子节点
+    if constexpr (Width == 8) {
+        return active_kernels().slab_test8(node.bounds_min, node.bounds_max, wr.org_min, wr.org_max, wr.inv_dir,
+            t_min, t_max, t_near) & node.valid;
+    }
+
+#if defined(RAGINE_WIDE_SSE)
+    if constexpr (Width % 4 == 0) {
+        for (int lane = 0; lane < Width; lane += 4) {
+            __m128 tn = _mm_set1_ps(t_min);
+            __m128 tf = _mm_set1_ps(t_max);
+            for (int axis = 0; axis < 3; axis++) {
+                __m128 o_min = _mm_set1_ps(wr.org_min[axis]);
+                __m128 o_max = _mm_set1_ps(wr.org_max[axis]);
+                __m128 inv = _mm_set1_ps(wr.inv_dir[axis]);
+                __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds_min[axis] + lane), o_min), inv);
+                __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds_max[axis] + lane), o_max), inv);
+                tn = _mm_max_ps(tn, _mm_min_ps(t0, t1));
+                tf = _mm_min_ps(tf, _mm_max_ps(t0, t1));
+            }
+            _mm_storeu_ps(t_near + lane, tn);
+            mask |= (uint32_t)_mm_movemask_ps(_mm_cmple_ps(tn, tf)) << lane;
+        }
+        return mask & node.valid;
+    }
+#endif
+
+    for (int i = 0; i < Width; i++) {
+        float tn = t_min, tf = t_max;
+        for (int axis = 0; axis < 3; axis++) {
+            float t0 = (node.bounds_min[axis][i] - wr.org_min[axis]) * wr.inv_dir[axis];
+            float t1 = (node.bounds_max[axis][i] - wr.org_max[axis]) * wr.inv_dir[axis];
+            tn = std::max(tn, std::min(t0, t1));
+            tf = std::min(tf, std::max(t0, t1));
+        }
+        t_near[i] = tn;
+        if (tn <= tf) mask |= 1u << i;
+    }
+    return mask & node.valid;
+}
+
+/// @brief 选出二叉节点 binary[index] 折叠成多叉节点后的子节点：不断展开表面积最大的内部子节点，直到凑满 width 个
+/// 叶子节点作为根时只返回它自己
+inline std::vector<uint32_t> wide_children(const mapped_array<linear_bvh_node>& binary, uint32_t index, int width) {
+    std::vector<uint32_t> children;
+    if (binary[index].count > 0) {
+        children.push_back(index);
+    } else {
+        children = {binary[index].offset, binary[index].offset + 1};
+    }
+
+    while ((int)children.size() < width) {
+        int best = -1;
+        double best_area = -1.0;
+        for (int i = 0; i < (int)children.size(); i++) {
+            const linear_bvh_node& c = binary[children[i]];
+            if (c.count > 0) continue;
+            double area = node_bounds(c).surface_area();
+            if (area > best_area) {
+                best_area = area;
+                best = i;
+            }
+        }
+        if (best < 0) break;
+
+        uint32_t expand = children[best];
+        children[best] = binary[expand].offset;
+        children.push_back(binary[expand].offset + 1);
+    }
+    return children;
+}
+
+/// @brief 多叉 BVH (Width = 4 为 QBVH，Width = 8 为 OBVH)
+/// 先构建二叉 LinearBVH，再把每个内部节点展开成最多 Width 个子节点
+template <int Width>
+class WideBVH : public Hittable {
+    static_assert(Width >= 2 && Width <= 32, "WideBVH width must be in [2, 32]");
+
+public:
+    aabb box;
+    std::vector<wide_bvh_node<Width>> nodes;
+    std::vector<std::shared_ptr<Hittable>> primitives;
+
+    WideBVH() {}
+
+    /// @brief 从 HittableList 构建多叉 BVH
+    /// @param time0 快门开启时间
+    /// @param time1 快门关闭时间
+    /// @param options 二叉树阶段的构建参数
+    WideBVH(const HittableList& list, double time0, double time1, const bvh_build_options& options = bvh_build_options()) {
+        LinearBVH binary(list, time0, time1, options);
+        if (binary.nodes.empty()) return;
+
+        box = binary.box;
+        primitives = std::move(binary.primitives);
+        nodes.reserve(binary.nodes.size() / 2 + 1);
+        collapse(binary.nodes, 0);
+    }
+
+    virtual bool is_hit(const ray& r, hit& record, double t_min, double t_max) const override {
+        return deferred_hit(r, record, t_min, t_max);
+    }
+
+    virtual bool intersect(const ray& r, double t_min, double t_max, hit_candidate& candidate) const override {
+        if (nodes.empty()) return false;
+
+        wide_ray wr = make_wide_ray(r, box);
+
+        struct entry { uint32_t index; uint32_t count; float t_near; };
+        entry stack[wide_stack_size(Width)];
+        int stack_size = 0;
+        stack[stack_size++] = {0, 0, (float)t_min};
+
+        bool hit_anything = false;
+        double closest_so_far = t_max;
+        float t_near[Width];
+
+        while (stack_size > 0) {
+            entry current = stack[--stack_size];
+            if (current.t_near > closest_so_far) continue;
+
+            if (current.count > 0) {
+                RAGINE_BVH_COUNT(primitive_tests, current.count);
+                for (uint32_t i = 0; i < current.count; i++) {
+                    if (primitives[current.index + i]->intersect(r, t_min, closest_so_far, candidate)) {
+                        hit_anything = true;
+                        closest_so_far = candidate.time;
+                    }
+                }
+                continue;
+            }
+
+            const wide_bvh_node<Width>& node = nodes[current.index];
+            RAGINE_BVH_COUNT(node_visits, 1);
+            // float 精度下稍微放宽远端距离，避免擦边光线漏掉包围盒
+            float t_far = (float)closest_so_far * 1.0001f;
+            uint32_t mask = wide_slab_test<Width>(node, wr, (float)t_min, t_far, t_near);
+
+            // 命中的子节点按距离从远到近压栈，出栈时先访问最近的子节点
+            int first = stack_size;
+            while (mask) {
+                int i = lowest_bit(mask);
+                mask &= mask - 1;
+
+                entry e{node.child[i], node.count[i], t_near[i]};
+                assert(stack_size < wide_stack_size(Width));
+                int j = stack_size++;
+                while (j > first && stack[j - 1].t_near < e.t_near) {
+                    stack[j] = stack[j - 1];
+                    j--;
+                }
+                stack[j] = e;
+            }
+        }
+
+        return hit_anything;
+    }
+
+    /// @brief any-hit 查询不需要按距离排序，命中的子节点直接压栈，第一个交点出现时立即返回
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        if (nodes.empty()) return false;
+
+        wide_ray wr = make_wide_ray(r, box);
+
+        struct entry { uint32_t index; uint32_t count; };
+        entry stack[wide_stack_size(Width)];
+        int stack_size = 0;
+        stack[stack_size++] = {0, 0};
+
+        float t_far = (float)t_max * 1.0001f;
+        float t_near[Width];
+
+        while (stack_size > 0) {
+            entry current = stack[--stack_size];
+
+            if (current.count > 0) {
+                for (uint32_t i = 0; i < current.count; i++) {
+                    RAGINE_BVH_COUNT(primitive_tests, 1);
+                    if (primitives[current.index + i]->is_occluded(r, t_min, t_max)) return true;
+                }
+                continue;
+            }
+
+            const wide_bvh_node<Width>& node = nodes[current.index];
+            RAGINE_BVH_COUNT(node_visits, 1);
+            uint32_t mask = wide_slab_test<Width>(node, wr, (float)t_min, t_far, t_near);
+            while (mask) {
+                int i = lowest_bit(mask);
+                mask &= mask - 1;
+                assert(stack_size < wide_stack_size(Width));
+                stack[stack_size++] = {node.child[i], node.count[i]};
+            }
+        }
+
+        return false;
+    }
+
+    virtual bool bounding_box(double t0, double t1, aabb& output_box) const override {
+        if (nodes.empty()) return false;
+        output_box = box;
+        return true;
+    }
+
+    virtual vec3 get_position() const override {
+        return {0.0, 0.0, 0.0};
+    }
+
+    /// @brief 统计节点数量、深度与期望遍历代价 (SAH cost)，每访问一个多叉节点计一次遍历代价
+    bvh_stats stats(const bvh_build_options& options = bvh_build_options()) const {
+        bvh_stats result;
+        if (nodes.empty()) return result;
+
+        double root_area = box.surface_area();
+        std::vector<std::pair<uint32_t, size_t>> pending{{0, 1}};
+        while (!pending.empty()) {
+            auto [index, depth] = pending.back();
+            pending.pop_back();
+
+            const wide_bvh_node<Width>& node = nodes[index];
+            aabb node_box = empty_box();
+            result.node_count++;
+            result.max_depth = std::max(result.max_depth, depth);
+
+            for (int i = 0; i < Width; i++) {
+                if (!(node.valid & (1u << i))) continue;
+                node_box = surrounding_box(node_box, child_bounds(node, i));
+                if (node.count[i] > 0) {
+                    result.leaf_count++;
+                    double weight = root_area > 0.0 ? child_bounds(node, i).surface_area() / root_area : 1.0;
+                    result.sah_cost += options.intersect_cost * weight * node.count[i];
+                } else {
+                    pending.push_back({node.child[i], depth + 1});
+                }
+            }
+            result.sah_cost += options.traversal_cost * (root_area > 0.0 ? node_box.surface_area() / root_area : 1.0);
+        }
+        return result;
+    }
+
+private:
+    static aabb child_bounds(const wide_bvh_node<Width>& node, int i) {
+        return aabb(
+            vec3{node.bounds_min[0][i], node.bounds_min[1][i], node.bounds_min[2][i]},
+            vec3{node.bounds_max[0][i], node.bounds_max[1][i], node.bounds_max[2][i]}
+        );
+    }
+
+    /// @brief 把以 binary[index] 为根的二叉子树折叠成一个多叉节点，返回该节点下标
+    uint32_t collapse(const mapped_array<linear_bvh_node>& binary, uint32_t index) {
+        std::vector<uint32_t> children = wide_children(binary, index, Width);
+
+        uint32_t node_index = (uint32_t)nodes.size();
+        nodes.emplace_back();
+        {
+            wide_bvh_node<Width>& node = nodes[node_index];
+            node.valid = 0;
+            for (int i = 0; i < Width; i++) {
+                for (int axis = 0; axis < 3; axis++) {
+                    node.bounds_min[axis][i] = INFINITY;
+                    node.bounds_max[axis][i] = -INFINITY;
+                }
+                node.child[i] = 0;
+                node.count[i] = 0;
+            }
+        }
+
+        for (int i = 0; i < (int)children.size(); i++) {
+            const linear_bvh_node& c = binary[children[i]];
+            uint32_t child = c.offset;
+            if (c.count == 0) child = collapse(binary, children[i]);
+
+            // collapse 可能导致 nodes 重新分配，这里重新取引用
+            wide_bvh_node<Width>& node = nodes[node_index];
+            for (int axis = 0; axis < 3; axis++) {
+                node.bounds_min[axis][i] = c.bounds_min[axis];
+                node.bounds_max[axis][i] = c.bounds_max[axis];
+            }
+            node.child[i] = child;
+            node.count[i] = c.count;
+            node.valid |= 1u << i;
+        }
+
+        return node_index;
+    }
+};
+
+using QBVH = WideBVH<4>;
+using OBVH = WideBVH<8>;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ragine.h"
+#include "random.h"
 
 class Camera {
     vec3 origin;
@@ -10,6 +11,8 @@ class Camera {
 
     bool allow_shadow;
     double focus_dist;
+    double shutter_open = 0.0;
+    double shutter_close = 0.0;
 
 public:
     /// @brief Camera 类构造函数
@@ -37,9 +40,17 @@ public:
         lower_left = origin - (horizontal * 0.5) - (vertical * 0.5) - (w * focus_dist);
     }
 
+    /// @brief 设置快门开启与关闭的时刻，每条光线的时刻在两者之间均匀随机，运动物体因此产生运动模糊
+    /// 两者相等 (默认均为 0) 时不产生运动模糊
+    void set_shutter(double open, double close) {
+        shutter_open = open;
+        shutter_close = close;
+    }
+
     ray get_ray(double s, double t) {
         return { origin,
-                 lower_left + horizontal * s + vertical * t - origin
+                 lower_left + horizontal * s + vertical * t - origin,
+                 shutter_close > shutter_open ? random_double(shutter_open, shutter_close) : shutter_open
         };
     }
 
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// @brief 热点核心可选的指令集级别，由低到高排列
+/// baseline 为编译器默认目标 (x86-64 上即 SSE2)，其余级别只在 GCC / Clang 的 x86 构建中提供
+enum class cpu_isa : int {
+    baseline = 0,
+    sse42 = 1,
+    avx2 = 2,
+    avx512 = 3,
+};
+
+/// @brief 一组热点核心，每个指令集级别各编译一份 (ragine/src/cpu_dispatch.cpp)，启动时按 CPUID 选择其中一份
+/// 同一份输入在各个级别下的结果逐位相同，只是每条指令处理的数据宽度不同
+/// 纹理采样不在其中：ImageTexture::value 每次只取一个最近的像素，没有可以加宽的批量；
+/// 载入时整张图转换成 float 只会让纹理变成 4 倍大，而采样本身并不会变快
+struct cpu_kernels {
+    cpu_isa isa;
+    size_t double_lanes;    // sphere_nearest 一次同时求交的球数
+
+    /// @brief 8 个包围盒 (SoA) 的 slab 测试，t_near 输出每个包围盒的进入距离，返回命中掩码
+    /// 下界与 org_min、上界与 org_max 相减 (见 wide_ray)
+    uint32_t (*slab_test8)(const float bounds_min[3][8], const float bounds_max[3][8], const float org_min[3],
+        const float org_max[3], const float inv_dir[3], float t_min, float t_max, float t_near[8]);
+
+    /// @brief 8 个量化包围盒的 slab 测试，下界 t = q_min * s[axis] + o_min[axis]，上界 t = q_max * s[axis] + o_max[axis]
+    uint32_t (*quantized_slab_test8)(const uint8_t q_min[3][8], const uint8_t q_max[3][8], const float s[3],
+        const float o_min[3], const float o_max[3], float t_min, float t_max, float t_near[8]);
+
+    /// @brief 与 Sphere::is_hit 相同的求根与区间判定，返回最近交点的下标 (没有交点时为 SIZE_MAX)，closest 更新为交点距离
+    size_t (*sphere_nearest)(const double* center_x, const double* center_y, const double* center_z,
+        const double* radius, size_t count, const double origin[3], const double dir[3],
+        double near_min, double far_min, double& closest, bool any_hit);
+
+    /// @brief watertight 三角形测试，vertex[顶点][轴] 已按光线的 kx ky kz 排列，shear 为 sx sy sz
+    /// lane_t[i] 为第 i 个三角形在 [near_min, far_max] 内的交点距离，没有交点时为 -1
+    void (*triangle_test)(const double* const vertex[3][3], uint32_t count, const double origin[3],
+        const double shear[3], double near_min, double far_max, double* lane_t);
+
+    /// @brief 把 [0, 1] 的颜色转换为 8 位 RGB，stride 为相邻像素之间的 double 个数
+    void (*float_to_rgb8)(const double* pixels, size_t stride, size_t count, uint8_t* out);
+};
+
+const char* cpu_isa_name(cpu_isa isa);
+
+/// @brief 由 CPUID 得到 CPU 与操作系统都支持的最高级别
+cpu_isa detect_cpu_isa();
+
+/// @brief 首次使用时调用：检测 CPU，环境变量 RAGINE_ISA (baseline / sse4.2 / avx2 / avx512) 可以强制指定较低的级别，
+/// 并在标准输出打印选中的级别
+const cpu_kernels* select_cpu_kernels();
+
+/// @brief 切换到指定级别 (不超过 CPU 支持的最高级别)，返回实际使用的级别
+/// 用于测试与基准对比，渲染过程中不要调用
+cpu_isa set_cpu_isa(cpu_isa isa);
+
+inline const cpu_kernels*& active_kernel_slot() {
+    static const cpu_kernels* active = select_cpu_kernels();
+    return active;
+}
+
+/// @brief 当前使用的热点核心
+inline const cpu_kernels& active_kernels() {
+    return *active_kernel_slot();
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "ragine.h"
+#include <memory>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define RAGINE_HAS_MMAP 1
+#endif
+
+/// @brief 只读打开的内存映射文件
+/// 映射为私有可写 (MAP_PRIVATE)：修改只发生在进程内的副本页上，不会写回文件，
+/// 因此直接引用映射内存的结构 (比如 refit 后的 BVH 节点) 也可以原地修改
+/// 不支持 mmap 的平台退化为一次性读入内存
+class mapped_file {
+public:
+    /// @brief 映射整个文件
+    /// @return 文件不存在或映射失败时返回 nullptr
+    static std::shared_ptr<mapped_file> open(const std::string& path) {
+        auto file = std::shared_ptr<mapped_file>(new mapped_file());
+
+#if defined(RAGINE_HAS_MMAP)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return nullptr;
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return nullptr;
+        }
+
+        void* address = mmap(nullptr, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED) return nullptr;
+
+        file->bytes = static_cast<char*>(address);
+        file->length = (size_t)info.st_size;
+#else
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) return nullptr;
+
+        file->buffer.resize((size_t)in.tellg());
+        in.seekg(0);
+        if (file->buffer.empty() || !in.read(file->buffer.data(), file->buffer.size())) return nullptr;
+
+        file->bytes = file->buffer.data();
+        file->length = file->buffer.size();
+#endif
+        return file;
+    }
+
+    ~mapped_file() {
+#if defined(RAGINE_HAS_MMAP)
+        if (bytes) munmap(bytes, length);
+#endif
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    char* data() { return bytes; }
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    mapped_file() {}
+
+    char* bytes = nullptr;
+    size_t length = 0;
+#if !defined(RAGINE_HAS_MMAP)
+    std::vector<char> buffer;
+#endif
+};
+
+/// @brief 类似 vector 的数组：既可以自己持有内存，也可以直接引用映射文件中的一段数据 (零拷贝)
+/// 引用映射文件时会同时持有该文件，保证数组存活期间映射不被释放；此时不能再追加元素
+/// 复制时总是把元素拷贝到新数组自己持有的内存中，修改副本 (比如 refit) 不会影响原数组引用的映射页
+template <typename T>
+class mapped_array {
+public:
+    mapped_array() {}
+
+    mapped_array(const mapped_array& other) : storage(other.begin(), other.end()) {
+        sync();
+    }
+
+    mapped_array& operator=(const mapped_array& other) {
+        if (this == &other) return *this;
+        storage.assign(other.begin(), other.end());
+        source.reset();
+        sync();
+        return *this;
+    }
+
+    /// @brief 移动后 vector 的缓冲区地址不变，items 仍然有效；被移走的数组清空，不再指向已经转交的内存
+    mapped_array(mapped_array&& other) noexcept
+        : storage(std::move(other.storage)), items(other.items), count(other.count), source(std::move(other.source)) {
+        other.items = nullptr;
+        other.count = 0;
+    }
+
+    mapped_array& operator=(mapped_array&& other) noexcept {
+        if (this == &other) return *this;
+        storage = std::move(other.storage);
+        items = other.items;
+        count = other.count;
+        source = std::move(other.source);
+        other.items = nullptr;
+        other.count = 0;
+        return *this;
+    }
+
+    /// @brief 引用 file 中从 offset 字节处开始的 n 个元素
+    void map(const std::shared_ptr<mapped_file>& file, size_t offset, size_t n) {
+        storage.clear();
+        storage.shrink_to_fit();
+        source = file;
+        items = reinterpret_cast<T*>(file->data() + offset);
+        count = n;
+    }
+
+    bool is_mapped() const { return source != nullptr; }
+
+    void reserve(size_t n) {
+        storage.reserve(n);
+        sync();
+    }
+
+    T& emplace_back() {
+        storage.emplace_back();
+        sync();
+        return storage.back();
+    }
+
+    T& operator[](size_t i) { return items[i]; }
+    const T& operator[](size_t i) const { return items[i]; }
+
+    T* data() { return items; }
+    const T* data() const { return items; }
+    T* begin() { return items; }
+    T* end() { return items + count; }
+    const T* begin() const { return items; }
+    const T* end() const { return items + count; }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+private:
+    void sync() {
+        items = storage.data();
+        count = storage.size();
+    }
+
+    std::vector<T> storage;
+    T* items = nullptr;
+    size_t count = 0;
+    std::shared_ptr<mapped_file> source;
+};
@@ -3,11 +3,21 @@
 #include "ragine.h"
 #include <random>
 
+/// @brief 当前线程的随机数生成器
+inline std::mt19937& random_generator() {
+    static thread_local std::mt19937 generator(std::random_device{}());
+    return generator;
+}
+
+/// @brief 为当前线程的随机数生成器设定种子，用于生成可复现的场景 (其他线程不受影响)
+inline void random_seed(uint32_t seed) {
+    random_generator().seed(seed);
+}
+
 /// @brief 生成 [0, 1) 的随机小数
 inline double random_double() {
-    static thread_local std::mt19937 generator(std::random_device{}()); 
     std::uniform_real_distribution<double> distribution(0.0, 1.0);
-    return distribution(generator);
+    return distribution(random_generator());
 }
 
 /// @brief 生成 [min, max) 的随机小数
@@ -1,84 +1,189 @@
 #pragma once
 
 #include <cmath>
+#include <cstdint>
 #include <memory>
+#include <type_traits>
+
+#if defined(RAGINE_SIMD_VEC3) && defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 class Material;
 
-struct vec3 {
+#if defined(RAGINE_SIMD_VEC3)
+/// @brief RAGINE_SIMD_VEC3：vec3_t 改为 4 通道对齐的 SIMD 向量 (第 4 个通道恒为 0)，接口与标量版本相同
+/// double 版本 32 字节，开启 AVX 时一条指令完成一次运算，否则拆成两条 SSE2 指令；float 版本 16 字节，对应一个 SSE 寄存器
+/// 所有翻译单元 (包括 ragine/src) 必须使用同一设置编译，例如都加上 -DRAGINE_SIMD_VEC3
+template <typename T>
+struct alignas(4 * sizeof(T)) vec3_t {
+    typedef T lanes __attribute__((vector_size(4 * sizeof(T))));
+    typedef std::conditional_t<sizeof(T) == 8, int64_t, int32_t> lane_index;
+    typedef lane_index lane_mask __attribute__((vector_size(4 * sizeof(T))));
+
+    union {
+        lanes v;
+        struct {
+            T x, y, z;
+        };
+        T vec3_data[4];
+    };
+
+    vec3_t(T x_val = 0, T y_val = 0, T z_val = 0) : v(lanes{x_val, y_val, z_val, 0}) {}
+
+    /// @brief 不同精度之间的转换需要显式写出
+    template <typename U>
+    explicit vec3_t(const vec3_t<U>& o) : vec3_t(T(o.x), T(o.y), T(o.z)) {}
+
+    /// @brief 直接使用 sqrtsd / sqrtss 指令：std::sqrt 为了设置 errno 会在负数时调用库函数，
+    /// 这条冷路径要求函数保存 32 字节对齐的寄存器，使每次调用都多出对齐栈的开销
+    static T root(T value) {
+#if defined(__SSE2__)
+        if constexpr (std::is_same_v<T, double>) return _mm_cvtsd_f64(_mm_sqrt_sd(_mm_set_sd(value), _mm_set_sd(value)));
+        else return _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(value)));
+#else
+        return std::sqrt(value);
+#endif
+    }
+
+    static vec3_t from_lanes(const lanes& l) {
+        vec3_t result;
+        result.v = l;
+        return result;
+    }
+
+    vec3_t operator+(const vec3_t& o) const { return from_lanes(v + o.v); }
+    vec3_t operator-(const vec3_t& o) const { return from_lanes(v - o.v); }
+    vec3_t operator*(const vec3_t& o) const { return from_lanes(v * o.v); }
+    vec3_t operator*(const T t) const { return from_lanes(v * t); }
+
+    /// @brief 点积只算一次，再乘以长度的倒数，代替三次除法
+    vec3_t normalize() const {
+        T len_squared = dot(*this);
+#if defined(__SSE2__)
+        if constexpr (std::is_same_v<T, float>) {
+            // rsqrt 近似值 (12 位) 加一步牛顿迭代，精度接近 1 / sqrt
+            float approx = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(len_squared)));
+            approx = approx * (1.5f - 0.5f * len_squared * approx * approx);
+            return from_lanes(v * approx);
+        }
+#endif
+        return from_lanes(v * (T(1) / root(len_squared)));
+    }
+    /// @brief a.yzx * b.zxy - a.zxy * b.yzx，第 4 个通道仍为 0
+    vec3_t cross(const vec3_t& o) const {
+        const lane_mask yzx{1, 2, 0, 3}, zxy{2, 0, 1, 3};
+        return from_lanes(__builtin_shuffle(v, yzx) * __builtin_shuffle(o.v, zxy) -
+                          __builtin_shuffle(v, zxy) * __builtin_shuffle(o.v, yzx));
+    }
+    vec3_t up() const { return { 0, 1, 0 }; }
+
+    T dot(const vec3_t& o) const {
+        lanes p = v * o.v;
+        return p[0] + p[1] + p[2];
+    }
+    T length_squared() const { return dot(*this); }
+    T length() const { return root(dot(*this)); }
+
+    T operator[](const int index) const {
+        return vec3_data[index];
+    }
+
+    T& operator[](const int index) {
+        return vec3_data[index];
+    }
+};
+#else
+/// @brief 三维向量，按标量类型模板化：引擎默认使用 double (vec3)，float 版本 (vec3f) 用于对比精度与速度
+template <typename T>
+struct vec3_t {
     union {
         struct {
-            double x, y, z;
+            T x, y, z;
         };
-        double vec3_data[3];
+        T vec3_data[3];
     };
 
-    vec3(double x_val = 0.0, double y_val = 0.0, double z_val = 0.0) : x(x_val), y(y_val), z(z_val) {}
+    vec3_t(T x_val = 0, T y_val = 0, T z_val = 0) : x(x_val), y(y_val), z(z_val) {}
+
+    /// @brief 不同精度之间的转换需要显式写出
+    template <typename U>
+    explicit vec3_t(const vec3_t<U>& v) : x(T(v.x)), y(T(v.y)), z(T(v.z)) {}
 
-    vec3 operator+(const vec3& v) const { return {x + v.x, y + v.y, z + v.z}; }
-    vec3 operator-(const vec3& v) const { return {x - v.x, y - v.y, z - v.z}; }
-    vec3 operator*(const vec3& v) const { return {x * v.x, y * v.y, z * v.z}; }
-    vec3 operator*(const double t) const { return {x * t, y * t, z * t}; }
+    vec3_t operator+(const vec3_t& v) const { return {x + v.x, y + v.y, z + v.z}; }
+    vec3_t operator-(const vec3_t& v) const { return {x - v.x, y - v.y, z - v.z}; }
+    vec3_t operator*(const vec3_t& v) const { return {x * v.x, y * v.y, z * v.z}; }
+    vec3_t operator*(const T t) const { return {x * t, y * t, z * t}; }
 
-    vec3 normalize() const {
-        double len = sqrt(x * x + y * y + z * z);
+    vec3_t normalize() const {
+        T len = std::sqrt(x * x + y * y + z * z);
         return {x / len, y / len, z / len};
     }
-    vec3 cross(const vec3& v) const { 
+    vec3_t cross(const vec3_t& v) const { 
         return {
             y * v.z - z * v.y,
             z * v.x - x * v.z,
             x * v.y - y * v.x
         };
     }
-    vec3 up() const { return { 0.0, 1.0, 0.0 }; }
+    vec3_t up() const { return { 0, 1, 0 }; }
 
-    double dot(const vec3& v) const { return x * v.x + y * v.y + z * v.z; }
-    double length_squared() const { return x * x + y * y + z * z; }
-    double length() const { return sqrt(x * x + y * y + z * z); }
+    T dot(const vec3_t& v) const { return x * v.x + y * v.y + z * v.z; }
+    T length_squared() const { return x * x + y * y + z * z; }
+    T length() const { return std::sqrt(x * x + y * y + z * z); }
 
-    double operator[](const int index) const {
+    T operator[](const int index) const {
         return vec3_data[index];
     }
 
-    double& operator[](const int index) {
+    T& operator[](const int index) {
         return vec3_data[index];
     }
 };
+#endif
 
-struct vec2 {
+template <typename T>
+struct vec2_t {
     union {
         struct {
-            double x, y;
+            T x, y;
         };
-        double vec2_data[2];
+        T vec2_data[2];
     };
 
-    vec2(double x_val = 0.0, double y_val = 0.0) : x(x_val), y(y_val) {}
+    vec2_t(T x_val = 0, T y_val = 0) : x(x_val), y(y_val) {}
 
-    vec2 operator+(const vec2& v) const { return {x + v.x, y + v.y}; }
-    vec2 operator-(const vec2& v) const { return {x - v.x, y - v.y}; }
-    vec2 operator*(const vec2& v) const { return {x * v.x, y * v.y}; }
-    vec2 operator*(const double t) const { return {x * t, y * t}; }
+    template <typename U>
+    explicit vec2_t(const vec2_t<U>& v) : x(T(v.x)), y(T(v.y)) {}
 
-    vec2 normalize() const {
-        double len = sqrt(x * x + y * y);
+    vec2_t operator+(const vec2_t& v) const { return {x + v.x, y + v.y}; }
+    vec2_t operator-(const vec2_t& v) const { return {x - v.x, y - v.y}; }
+    vec2_t operator*(const vec2_t& v) const { return {x * v.x, y * v.y}; }
+    vec2_t operator*(const T t) const { return {x * t, y * t}; }
+
+    vec2_t normalize() const {
+        T len = std::sqrt(x * x + y * y);
         return {x / len, y / len};
     }
 
-    double dot(const vec3& v) const { return x * v.x + y * v.y; }
-    double length_squared() const { return x * x + y * y; }
-    double length() const { return sqrt(x * x + y * y); }
+    T dot(const vec3_t<T>& v) const { return x * v.x + y * v.y; }
+    T length_squared() const { return x * x + y * y; }
+    T length() const { return std::sqrt(x * x + y * y); }
 
-    double operator[](const int index) const {
+    T operator[](const int index) const {
         return vec2_data[index];
     }
 
-    double& operator[](const int index) {
+    T& operator[](const int index) {
         return vec2_data[index];
     }
 };
 
+using vec3 = vec3_t<double>;
+using vec2 = vec2_t<double>;
+using vec3f = vec3_t<float>;
+using vec2f = vec2_t<float>;
+
 struct hit_legend {
     vec3 position;
     vec3 normal;
@@ -86,17 +191,27 @@ struct hit_legend {
     double time;
 };
 
-struct hit {
-    vec3 position;
-    vec3 normal;
+/// @brief 交点信息，按标量类型 T 实例化；uv 交给 Texture 采样，各精度都用 double
+template <typename T>
+struct hit_t {
+    vec3_t<T> position;
+    vec3_t<T> normal;
     Material* material;
-    double time;
+    T time;
 
     vec2 uv;
 };
 
-struct ray {
-    vec3 origin;
-    vec3 dir;
-    vec3 at(const double time) const { return origin + dir * time; }
+using hit = hit_t<double>;
+using hitf = hit_t<float>;
+
+template <typename T>
+struct ray_t {
+    vec3_t<T> origin;
+    vec3_t<T> dir;
+    double time = 0.0;  // 光线发出的时刻，运动物体按该时刻计算位置
+    vec3_t<T> at(const T time) const { return origin + dir * time; }
 };
+
+using ray = ray_t<double>;
+using rayf = ray_t<float>;
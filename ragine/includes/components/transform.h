@@ -0,0 +1,120 @@
+#pragma once
+
+#include "ragine.h"
+#include <cassert>
+
+/// @brief 3x4 仿射变换矩阵 (最后一行隐含为 0 0 0 1)
+struct affine_transform {
+    double m[3][4];
+
+    affine_transform() {
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 4; j++) m[i][j] = (i == j) ? 1.0 : 0.0;
+    }
+
+    static affine_transform identity() { return affine_transform(); }
+
+    static affine_transform translate(const vec3& offset) {
+        affine_transform t;
+        t.m[0][3] = offset.x;
+        t.m[1][3] = offset.y;
+        t.m[2][3] = offset.z;
+        return t;
+    }
+
+    static affine_transform scale(const vec3& factor) {
+        affine_transform t;
+        t.m[0][0] = factor.x;
+        t.m[1][1] = factor.y;
+        t.m[2][2] = factor.z;
+        return t;
+    }
+
+    /// @brief 绕任意轴旋转 (Rodrigues 公式)
+    /// @param axis 旋转轴 (无需单位化)
+    /// @param degrees 旋转角度 (度)
+    static affine_transform rotate(const vec3& axis, double degrees) {
+        vec3 a = axis.normalize();
+        double theta = degrees * M_PI / 180.0;
+        double c = std::cos(theta), s = std::sin(theta), k = 1.0 - c;
+
+        affine_transform t;
+        t.m[0][0] = a.x * a.x * k + c;       t.m[0][1] = a.x * a.y * k - a.z * s; t.m[0][2] = a.x * a.z * k + a.y * s;
+        t.m[1][0] = a.y * a.x * k + a.z * s; t.m[1][1] = a.y * a.y * k + c;       t.m[1][2] = a.y * a.z * k - a.x * s;
+        t.m[2][0] = a.z * a.x * k - a.y * s; t.m[2][1] = a.z * a.y * k + a.x * s; t.m[2][2] = a.z * a.z * k + c;
+        return t;
+    }
+
+    /// @brief 组合变换，结果先应用 t 再应用 *this
+    affine_transform operator*(const affine_transform& t) const {
+        affine_transform r;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 4; j++) {
+                r.m[i][j] = m[i][0] * t.m[0][j] + m[i][1] * t.m[1][j] + m[i][2] * t.m[2][j] + (j == 3 ? m[i][3] : 0.0);
+            }
+        }
+        return r;
+    }
+
+    /// @brief 线性部分的行列式
+    double determinant() const {
+        return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+             - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+             + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    }
+
+    /// @brief 线性部分是否可逆：|det| 不超过三行长度之积 (Hadamard 不等式)，两者之比与整体缩放无关，
+    /// 比值低于 tolerance 视为奇异 (比如某个轴的缩放为 0)；含 inf / NaN 时同样返回 false
+    bool is_invertible(double tolerance = 1e-12) const {
+        double bound = 1.0;
+        for (int i = 0; i < 3; i++) bound *= std::sqrt(m[i][0] * m[i][0] + m[i][1] * m[i][1] + m[i][2] * m[i][2]);
+        return std::fabs(determinant()) > tolerance * bound && std::isfinite(bound);
+    }
+
+    /// @brief 逆变换 (要求线性部分可逆，调用前用 is_invertible 检查)
+    affine_transform inverse() const {
+        assert(is_invertible());
+        double inv_det = 1.0 / determinant();
+
+        affine_transform r;
+        r.m[0][0] =  (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * inv_det;
+        r.m[0][1] = -(m[0][1] * m[2][2] - m[0][2] * m[2][1]) * inv_det;
+        r.m[0][2] =  (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inv_det;
+        r.m[1][0] = -(m[1][0] * m[2][2] - m[1][2] * m[2][0]) * inv_det;
+        r.m[1][1] =  (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inv_det;
+        r.m[1][2] = -(m[0][0] * m[1][2] - m[0][2] * m[1][0]) * inv_det;
+        r.m[2][0] =  (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * inv_det;
+        r.m[2][1] = -(m[0][0] * m[2][1] - m[0][1] * m[2][0]) * inv_det;
+        r.m[2][2] =  (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inv_det;
+
+        for (int i = 0; i < 3; i++) {
+            r.m[i][3] = -(r.m[i][0] * m[0][3] + r.m[i][1] * m[1][3] + r.m[i][2] * m[2][3]);
+        }
+        return r;
+    }
+
+    vec3 point(const vec3& p) const {
+        return {
+            m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+            m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+            m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]
+        };
+    }
+
+    vec3 vector(const vec3& v) const {
+        return {
+            m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+            m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+            m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z
+        };
+    }
+
+    /// @brief 用线性部分的转置变换向量，在逆矩阵上调用即可得到正确的法线变换
+    vec3 transpose_vector(const vec3& v) const {
+        return {
+            m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z,
+            m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z,
+            m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z
+        };
+    }
+};
@@ -2,6 +2,9 @@
 
 #include "ragine.h"
 #include "stb_image.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
 
 vec3 gamma_correct(const vec3& origin);
 vec3 sampled_gamma(const vec3& origin, int sample_times);
@@ -9,6 +12,49 @@ vec3 reflect(const vec3& v, const vec3& n);
 vec3 refract(const vec3& uv, const vec3& n, double etai_over_etat);
 double reflectance(double cosine, double ref_idx);
 
+/// @brief 把 [0, 1] 的颜色写成二进制 PPM (P6)，8 位转换由运行时选择的核心完成
+bool write_ppm(const std::string& file_path, const std::vector<vec3>& image, int width, int height);
+
+/// @brief offset_ray_origin 使用的常量：远离原点时按整数 ulp 偏移，靠近原点时 (ulp 太小) 按固定距离偏移
+template <typename T> struct ray_offset_constants;
+
+template <> struct ray_offset_constants<float> {
+    using bits = int32_t;
+    static constexpr float origin = 1.0f / 32.0f;
+    static constexpr float float_scale = 1.0f / 65536.0f;
+    static constexpr float int_scale = 256.0f;
+};
+
+template <> struct ray_offset_constants<double> {
+    using bits = int64_t;
+    static constexpr double origin = 1.0 / 32.0;
+    static constexpr double float_scale = 0x1p-45;
+    static constexpr double int_scale = 256.0;
+};
+
+/// @brief 把交点沿法线方向挪到表面外侧，作为次级光线的起点 (Wächter & Binder, Ray Tracing Gems 第 6 章)
+/// 偏移量与坐标的 ulp 成正比，场景尺度变化时仍然有效，次级光线可以用 t_min = 0 求交，不再依赖 MINIMUM 这样的固定阈值
+/// @param n 朝向光线出射一侧的法线
+template <typename T>
+vec3_t<T> offset_ray_origin(const vec3_t<T>& p, const vec3_t<T>& n) {
+    using constants = ray_offset_constants<T>;
+    using bits = typename constants::bits;
+
+    vec3_t<T> result;
+    for (int axis = 0; axis < 3; axis++) {
+        if (std::fabs(p[axis]) < constants::origin) {
+            result[axis] = p[axis] + constants::float_scale * n[axis];
+            continue;
+        }
+        bits offset = (bits)(constants::int_scale * n[axis]);
+        bits value;
+        std::memcpy(&value, &p.vec3_data[axis], sizeof(value));
+        value += p[axis] < 0 ? -offset : offset;
+        std::memcpy(&result.vec3_data[axis], &value, sizeof(value));
+    }
+    return result;
+}
+
 struct Colors {
     inline static const vec3 Black   {0.0, 0.0, 0.0};
     inline static const vec3 White   {1.0, 1.0, 1.0};
@@ -1,10 +1,17 @@
 #pragma once
 
 #include "ragine.h"
+#include "../ray_tracing/object.h"
 
 class Hittable_legend {
 public:
     virtual bool is_hit(const ray& r, hit_legend& record, double t_min, double t_max) const = 0;
+
+    /// @brief 可见性查询 (any-hit)：找到任意一个交点即返回，不计算交点属性，默认实现退化为 is_hit
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const {
+        hit_legend temp;
+        return is_hit(r, temp, t_min, t_max);
+    }
 };
 
 class HittableList_legend : public Hittable_legend {
@@ -27,6 +34,13 @@ public:
 
         return hit_anything;
     }
+
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        for (const auto& object: objects) {
+            if (object->is_occluded(r, t_min, t_max)) return true;
+        }
+        return false;
+    }
 };
 
 class Sphere_legend : public Hittable_legend {
@@ -42,22 +56,8 @@ public:
     Sphere_legend(const vec3& cent, const double r, const vec3& col) : center(cent), radius(r), color(col) {}
 
     virtual bool is_hit(const ray& r, hit_legend& record, double t_min, double t_max) const override {
-        vec3 co = r.origin - center;
-        double a = r.dir.dot(r.dir);
-        double b = 2.0 * co.dot(r.dir);
-        double c = co.dot(co) - radius * radius;
-        double discriminant = b * b - 4 * a * c;
-
-        if (discriminant < 0) return false;
-
-        double sqrtd = std::sqrt(discriminant);
-
-        double root = (-b - sqrtd) / (2.0 * a);
-
-        if (root < std::max(MINIMUM, t_min) || root > t_max) {
-            root = (-b + sqrtd) / (2.0 * a);
-            if (root < std::min(0.001, t_min) || root > t_max) return false;
-        }
+        double root;
+        if (!Sphere::solve_root(r, center, radius, t_min, t_max, root)) return false;
 
         record.time = root;
         record.position = r.origin + r.dir * root;
@@ -66,6 +66,11 @@ public:
 
         return true;
     }
+
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        double root;
+        return Sphere::solve_root(r, center, radius, t_min, t_max, root);
+    }
 };
 
 class Plane_legend : public Hittable_legend {
@@ -100,4 +105,13 @@ public:
 
         return true;
     }
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        double denominator = r.dir.dot(normal);
+
+        if (std::abs(denominator) < 1e-6) return false;
+
+        double root = (locate - r.origin).dot(normal) / denominator;
+
+        return root >= std::max(MINIMUM, t_min) && root <= t_max;
+    }
 };
@@ -20,10 +20,13 @@ Created by Everett Rain 2025-11-27 (MIT License)
 
 // RAGINE - Components
 #include "components/struct.h"
+#include "components/transform.h"
 #include "components/utils.h"
 #include "components/component.h"
 #include "components/random.h"
 #include "components/texture.h"
+#include "components/mapped_file.h"
+#include "components/cpu_dispatch.h"
 
 // RAGINE - Legend APIs
 #include "legend/shader.h"
@@ -31,9 +34,25 @@ Created by Everett Rain 2025-11-27 (MIT License)
 
 // RAGINE - BVH Optimization
 #include "bvh/aabb.h"
+#include "bvh/morton.h"
+#include "bvh/bvh_build.h"
+#include "bvh/bvh_cache.h"
 #include "bvh/bvh.h"
+#include "bvh/linear_bvh.h"
+#include "bvh/wide_bvh.h"
+#include "bvh/compressed_bvh.h"
+#include "bvh/motion_bvh.h"
+#include "bvh/grid_accel.h"
+#include "bvh/kd_tree.h"
+#include "bvh/instance.h"
+#include "bvh/scene.h"
+#include "bvh/accelerator.h"
 
 // RAGINE - Ray Tracing
 #include "ray_tracing/material.h"
 #include "ray_tracing/object.h"
+#include "ray_tracing/sphere_set.h"
+#include "ray_tracing/triangle_mesh.h"
+#include "ray_tracing/obj_loader.h"
+#include "ray_tracing/precision.h"
 #include "ray_tracing/ray_tracing.h"
\ No newline at end of file
@@ -17,6 +17,7 @@ public:
         ray new_ray;
         new_ray.origin = record.position;
         new_ray.dir = (record.normal + random_unit_vector());
+        new_ray.time = ray_in.time;
 
         if (new_ray.dir.length() < 1e-8) new_ray.dir = record.normal;
         new_ray.dir = new_ray.dir.normalize();
@@ -35,6 +36,7 @@ public:
         ray new_ray;
         new_ray.origin = record.position;
         new_ray.dir = reflect(ray_in.dir.normalize(), record.normal);
+        new_ray.time = ray_in.time;
         vec3 fuzz_fix = random_unit_vector() * fuzz;
         
         new_ray.dir = (new_ray.dir + fuzz_fix).normalize();
@@ -67,7 +69,7 @@ public:
             direction = refract(unit_direction, correct_normal, refraction_ratio);
         }
         
-        ray_out = {record.position, direction};
+        ray_out = {record.position, direction, ray_in.time};
         return true;
     }
 };
\ No newline at end of file
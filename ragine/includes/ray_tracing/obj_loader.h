@@ -0,0 +1,228 @@
+#pragma once
+
+#include "ragine.h"
+#include "triangle_mesh.h"
+#include <charconv>
+#include <cstdint>
+#include <omp.h>
+#include <string>
+#include <vector>
+
+/// @brief OBJ 面的一个角：位置、纹理坐标、法线的 0 起始下标，-1 表示缺省
+/// OBJ 的负数下标相对于该行之前已出现的顶点，分块解析时先记为块内下标，合并时再加上之前各块的顶点数
+struct obj_corner {
+    int64_t index[3];
+    uint8_t relative;   // 第 k 位为 1 表示 index[k] 是块内下标
+};
+
+/// @brief 一个分块的解析结果，属性按出现顺序存放，corners 中每 3 个为一个三角形
+struct obj_chunk {
+    std::vector<vec3> positions;
+    std::vector<vec2> uvs;
+    std::vector<vec3> normals;
+    std::vector<obj_corner> corners;
+    size_t malformed = 0;
+};
+
+inline const char* obj_skip_space(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+inline const char* obj_next_line(const char* p, const char* end) {
+    while (p < end && *p != '\n') p++;
+    return p < end ? p + 1 : end;
+}
+
+inline bool obj_parse_double(const char*& p, const char* end, double& value) {
+    p = obj_skip_space(p, end);
+    if (p < end && *p == '+') p++;
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) return false;
+    p = result.ptr;
+    return true;
+}
+
+/// @brief 解析面的一个角 (v、v/vt、v//vn 或 v/vt/vn)
+/// @param counts 该行之前块内已出现的位置、纹理坐标、法线数量，用于换算负数下标
+inline bool obj_parse_corner(const char*& p, const char* end, const size_t counts[3], obj_corner& corner) {
+    corner = {{-1, -1, -1}, 0};
+    for (int k = 0; k < 3; k++) {
+        if (k > 0) {
+            if (p >= end || *p != '/') break;
+            p++;
+            if (k == 1 && p < end && *p == '/') continue;
+        }
+
+        int64_t raw = 0;
+        std::from_chars_result result = std::from_chars(p, end, raw);
+        if (result.ec != std::errc() || raw == 0) return false;
+        p = result.ptr;
+
+        if (raw > 0) {
+            corner.index[k] = raw - 1;
+        } else {
+            corner.index[k] = (int64_t)counts[k] + raw;
+            corner.relative |= (uint8_t)(1 << k);
+        }
+    }
+    return true;
+}
+
+/// @brief 解析 [begin, end) 内的完整行，多边形面按扇形拆成三角形，其他语句 (o / g / usemtl 等) 忽略
+inline void obj_parse_chunk(const char* begin, const char* end, obj_chunk& chunk) {
+    std::vector<obj_corner> polygon;
+
+    for (const char* p = begin; p < end; p = obj_next_line(p, end)) {
+        p = obj_skip_space(p, end);
+        if (p + 1 >= end) continue;
+
+        if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            vec3 position;
+            p += 2;
+            if (obj_parse_double(p, end, position.x) && obj_parse_double(p, end, position.y) && obj_parse_double(p, end, position.z)) {
+                chunk.positions.push_back(position);
+            } else {
+                chunk.malformed++;
+            }
+        } else if (p[0] == 'v' && p[1] == 't') {
+            vec2 uv{0.0, 0.0};
+            p += 2;
+            // 只有 u 的一维纹理坐标也是合法的
+            if (obj_parse_double(p, end, uv.x)) {
+                obj_parse_double(p, end, uv.y);
+                chunk.uvs.push_back(uv);
+            } else {
+                chunk.malformed++;
+            }
+        } else if (p[0] == 'v' && p[1] == 'n') {
+            vec3 normal;
+            p += 2;
+            if (obj_parse_double(p, end, normal.x) && obj_parse_double(p, end, normal.y) && obj_parse_double(p, end, normal.z)) {
+                chunk.normals.push_back(normal);
+            } else {
+                chunk.malformed++;
+            }
+        } else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            const size_t counts[3] = {chunk.positions.size(), chunk.uvs.size(), chunk.normals.size()};
+            polygon.clear();
+            p = obj_skip_space(p + 2, end);
+            bool valid = true;
+            while (p < end && *p != '\n' && *p != '#') {
+                obj_corner corner;
+                if (!obj_parse_corner(p, end, counts, corner)) {
+                    valid = false;
+                    break;
+                }
+                polygon.push_back(corner);
+                p = obj_skip_space(p, end);
+            }
+
+            if (!valid || polygon.size() < 3) {
+                chunk.malformed++;
+                continue;
+            }
+            for (size_t i = 1; i + 1 < polygon.size(); i++) {
+                chunk.corners.push_back(polygon[0]);
+                chunk.corners.push_back(polygon[i]);
+                chunk.corners.push_back(polygon[i + 1]);
+            }
+        }
+    }
+}
+
+/// @brief 加载 OBJ 文件为三角形网格并构建 BVH
+/// 文件以内存映射方式打开，按行边界切成若干块由 OpenMP 并行解析，再按块的顺序合并，结果与顺序解析相同
+/// 支持 v / vt / vn / f 语句与负数下标；材质库 (mtllib) 不读取，整个网格使用 material
+/// @return 文件无法打开时返回 nullptr
+inline std::shared_ptr<TriangleMesh> load_obj(const std::string& path, const std::shared_ptr<Material>& material,
+    const bvh_build_options& options = TriangleMesh::default_build_options()) {
+    std::shared_ptr<mapped_file> file = mapped_file::open(path);
+    if (!file) {
+        std::cerr << "ERROR: Could not load OBJ file '" << path << "'.\n";
+        return nullptr;
+    }
+
+    // 每块至少 1 MB，块数多于线程数以平衡各块内容不均匀的情况
+    const char* data = file->data();
+    size_t size = file->size();
+    size_t chunk_count = std::max<size_t>(1, std::min<size_t>((size_t)omp_get_max_threads() * 8, size >> 20));
+    std::vector<size_t> bounds(chunk_count + 1, size);
+    bounds[0] = 0;
+    for (size_t i = 1; i < chunk_count; i++) {
+        const char* p = obj_next_line(data + std::max(bounds[i - 1], size / chunk_count * i), data + size);
+        bounds[i] = (size_t)(p - data);
+    }
+
+    std::vector<obj_chunk> chunks(chunk_count);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (long long i = 0; i < (long long)chunk_count; i++) {
+        obj_parse_chunk(data + bounds[i], data + bounds[i + 1], chunks[i]);
+    }
+
+    // 每块的属性与三角形在合并结果中的起始位置
+    std::vector<size_t> first_position(chunk_count + 1, 0), first_uv(chunk_count + 1, 0);
+    std::vector<size_t> first_normal(chunk_count + 1, 0), first_corner(chunk_count + 1, 0);
+    size_t malformed = 0;
+    for (size_t i = 0; i < chunk_count; i++) {
+        first_position[i + 1] = first_position[i] + chunks[i].positions.size();
+        first_uv[i + 1] = first_uv[i] + chunks[i].uvs.size();
+        first_normal[i + 1] = first_normal[i] + chunks[i].normals.size();
+        first_corner[i + 1] = first_corner[i] + chunks[i].corners.size();
+        malformed += chunks[i].malformed;
+    }
+
+    auto mesh = std::make_shared<TriangleMesh>(material);
+    mesh->positions.resize(first_position[chunk_count]);
+    mesh->uvs.resize(first_uv[chunk_count]);
+    mesh->normals.resize(first_normal[chunk_count]);
+    mesh->indices.resize(first_corner[chunk_count]);
+    const size_t limits[3] = {mesh->positions.size(), mesh->uvs.size(), mesh->normals.size()};
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (long long i = 0; i < (long long)chunk_count; i++) {
+        obj_chunk& chunk = chunks[i];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), mesh->positions.begin() + first_position[i]);
+        std::copy(chunk.uvs.begin(), chunk.uvs.end(), mesh->uvs.begin() + first_uv[i]);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), mesh->normals.begin() + first_normal[i]);
+
+        const size_t offsets[3] = {first_position[i], first_uv[i], first_normal[i]};
+        for (size_t c = 0; c < chunk.corners.size(); c++) {
+            const obj_corner& corner = chunk.corners[c];
+            uint32_t resolved[3];
+            for (int k = 0; k < 3; k++) {
+                int64_t index = corner.index[k];
+                if (corner.relative & (1 << k)) index += (int64_t)offsets[k];
+                else if (index < 0) {
+                    resolved[k] = mesh_vertex::none;
+                    continue;
+                }
+                // 越界的下标记为无效位置，合并后整个三角形被丢弃
+                resolved[k] = index >= 0 && (size_t)index < limits[k] ? (uint32_t)index : mesh_vertex::none;
+                if (resolved[k] == mesh_vertex::none) resolved[0] = mesh_vertex::none;
+            }
+            mesh->indices[first_corner[i] + c] = {resolved[0], resolved[2], resolved[1]};
+        }
+        chunk = obj_chunk();
+    }
+
+    // 丢弃引用了不存在顶点的三角形
+    size_t kept = 0;
+    for (size_t t = 0; t < mesh->triangle_count(); t++) {
+        const mesh_vertex* corner = &mesh->indices[3 * t];
+        if (corner[0].position == mesh_vertex::none || corner[1].position == mesh_vertex::none ||
+            corner[2].position == mesh_vertex::none) continue;
+        if (kept != t) std::copy(corner, corner + 3, mesh->indices.begin() + 3 * kept);
+        kept++;
+    }
+    size_t dropped = mesh->triangle_count() - kept;
+    mesh->indices.resize(3 * kept);
+
+    if (malformed > 0 || dropped > 0) {
+        std::cerr << "WARNING: OBJ file '" << path << "' has " << malformed << " malformed lines and "
+            << dropped << " faces with invalid indices, which were skipped.\n";
+    }
+
+    mesh->build(options);
+    return mesh;
+}
@@ -1,18 +1,71 @@
 #pragma once
 
 #include "ragine.h"
+#include "../bvh/aabb.h"
+
+class Hittable;
+
+/// @brief 延迟计算交点属性时记录的最近交点：只有距离与图元编号，位置、法线、纹理坐标与材质留给 finalize_hit
+struct hit_candidate {
+    double time;
+    const Hittable* object = nullptr;   // 交点所属的物体，由它的 finalize_hit 计算交点属性
+    uint32_t primitive = 0;             // 物体内部的图元编号 (比如球体批、三角形批中的下标)
+    double u = 0.0, v = 0.0;            // 求交时顺便得到、之后还要用的参数 (比如三角形的重心坐标)
+    const Hittable* instance = nullptr; // 交点所在的实例，finalize_hit 由实例先把光线变换到物体空间
+    double t_min = 0.0;                 // 默认的 finalize_hit 用 [t_min, time] 重新求交一次
+};
 
 class Hittable {
 public:
     virtual bool is_hit(const ray& r, hit& record, double t_min, double t_max) const = 0;
     virtual vec3 get_position() const = 0;
 
+    /// @brief 延迟求交：只找出 (t_min, t_max) 内的最近交点，把距离与图元编号写入 candidate，不计算交点属性
+    /// 容器与加速结构把同一个 candidate 逐层传下去，遍历结束后只为最终的交点调用一次 finalize_hit，
+    /// 中途被更近交点取代的图元不再计算法线、纹理坐标 (三角函数) 等属性
+    /// 默认实现退化为 is_hit，只实现了 is_hit 的物体也能放进任何容器
+    /// @return 找到比 t_max 更近的交点时返回 true 并覆盖 candidate，否则不修改 candidate
+    virtual bool intersect(const ray& r, double t_min, double t_max, hit_candidate& candidate) const {
+        hit temp;
+        if (!is_hit(r, temp, t_min, t_max)) return false;
+        candidate = {temp.time, this};
+        candidate.t_min = t_min;
+        return true;
+    }
+
+    /// @brief 为 intersect 记录的交点计算完整的交点属性，candidate.object 为 this
+    /// 默认实现在 [t_min, time] 内重新调用一次 is_hit
+    virtual void finalize_hit(const ray& r, const hit_candidate& candidate, hit& record) const {
+        is_hit(r, record, candidate.t_min, candidate.time);
+    }
+
+    /// @brief 为最终的交点计算交点属性：交点在实例内时交给实例，否则交给交点所属的物体
+    static void finalize_candidate(const ray& r, const hit_candidate& candidate, hit& record) {
+        const Hittable* owner = candidate.instance ? candidate.instance : candidate.object;
+        owner->finalize_hit(r, candidate, record);
+    }
+
+    /// @brief 先用 intersect 找出最近交点，再只为它调用一次 finalize_hit；实现了 intersect 的物体用它实现 is_hit
+    bool deferred_hit(const ray& r, hit& record, double t_min, double t_max) const {
+        hit_candidate candidate;
+        if (!intersect(r, t_min, t_max, candidate)) return false;
+        finalize_candidate(r, candidate, record);
+        return true;
+    }
+
     /// @brief 判断该物体是否有包围盒
     /// @param t0 进入包围盒时间
     /// @param t1 离开包围盒时间
     /// @param output_box 生成的该物体的包围盒
     /// @return 如果物体有包围盒返回 true (比如球)，如果是无限物体返回 false (比如无限平面)
     virtual bool bounding_box(double t0, double t1, aabb& output_box) const = 0;
+
+    /// @brief 可见性查询 (any-hit)：只判断 (t_min, t_max) 内是否有遮挡，找到任意一个交点即返回，不计算交点属性
+    /// 阴影光线只关心光源是否被挡住，应优先使用该接口；默认实现退化为 is_hit
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const {
+        hit temp;
+        return is_hit(r, temp, t_min, t_max);
+    }
 };
 
 class HittableList : public Hittable {
@@ -23,20 +76,27 @@ public:
     HittableList(std::vector<std::shared_ptr<Hittable>> i_objects) : objects(std::move(i_objects)) {}
     void add(std::shared_ptr<Hittable> object) { objects.push_back(object); }
     virtual bool is_hit(const ray& r, hit& record, double t_min, double t_max) const override {
-        hit temp;
+        return deferred_hit(r, record, t_min, t_max);
+    }
+    virtual bool intersect(const ray& r, double t_min, double t_max, hit_candidate& candidate) const override {
         bool hit_anything = false;
         double closet_so_far = t_max;
 
         for (const auto& object: objects) {
-            if (object->is_hit(r, temp, t_min, closet_so_far)) {
+            if (object->intersect(r, t_min, closet_so_far, candidate)) {
                 hit_anything = true;
-                closet_so_far = temp.time;
-                record = temp;
+                closet_so_far = candidate.time;
             }
         }
 
         return hit_anything;
     }
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        for (const auto& object: objects) {
+            if (object->is_occluded(r, t_min, t_max)) return true;
+        }
+        return false;
+    }
     virtual vec3 get_position() const override {
         return {0.0, 0.0, 0.0};
     }
@@ -90,31 +150,57 @@ public:
     }
 
     virtual bool is_hit(const ray& r, hit& record, double t_min, double t_max) const override {
-        vec3 co = r.origin - center;
-        double a = r.dir.dot(r.dir);
-        double b = 2.0 * co.dot(r.dir);
-        double c = co.dot(co) - radius * radius;
-        double discriminant = b * b - 4 * a * c;
+        return deferred_hit(r, record, t_min, t_max);
+    }
+
+    /// @brief 光线与球心为 cent、半径为 r 的球求交：先取近根，不在区间内再取远根
+    /// 按标量类型 T 实例化，PrecisionScene<float> 用 float 版本，double 版本与原来的结果逐位相同
+    /// @param root 输出交点距离
+    /// @param epsilon 近根的下限，引擎用 MINIMUM 排除自相交；起点已经用 offset_ray_origin 挪开时传 0
+    template <typename T>
+    static bool solve_root(const ray_t<T>& r, const vec3_t<T>& cent, T rad, T t_min, T t_max, T& root,
+        T epsilon = T(MINIMUM)) {
+        vec3_t<T> co = r.origin - cent;
+        T a = r.dir.dot(r.dir);
+        T b = T(2) * co.dot(r.dir);
+        T c = co.dot(co) - rad * rad;
+        T discriminant = b * b - T(4) * a * c;
 
         if (discriminant < 0) return false;
 
-        double sqrtd = std::sqrt(discriminant);
+        T sqrtd = std::sqrt(discriminant);
 
-        double root = (-b - sqrtd) / (2.0 * a);
+        root = (-b - sqrtd) / (T(2) * a);
 
-        if (root < std::max(MINIMUM, t_min) || root > t_max) {
-            root = (-b + sqrtd) / (2.0 * a);
-            if (root < std::min(0.001, t_min) || root > t_max) return false;
+        if (root < std::max(epsilon, t_min) || root > t_max) {
+            root = (-b + sqrtd) / (T(2) * a);
+            if (root < std::min(T(0.001), t_min) || root > t_max) return false;
         }
+        return true;
+    }
+
+    virtual bool intersect(const ray& r, double t_min, double t_max, hit_candidate& candidate) const override {
+        double root;
+        if (!solve_root(r, center, radius, t_min, t_max, root)) return false;
+
+        candidate = {root, this};
+        return true;
+    }
 
-        record.time = root;
-        record.position = r.origin + r.dir * root;
+    virtual void finalize_hit(const ray& r, const hit_candidate& candidate, hit& record) const override {
+        record.time = candidate.time;
+        record.position = r.origin + r.dir * candidate.time;
         record.normal = (record.position - center) * (1.0 / radius);
 
         get_sphere_uv(record.normal, record.uv);
 
         record.material = material.get();
-        return true;
+    }
+
+    /// @brief 与 intersect 使用同一个 solve_root，可见性查询与最近交点的判定逐位一致
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        double root;
+        return solve_root(r, center, radius, t_min, t_max, root);
     }
 
     virtual bool bounding_box(double t0, double t1, aabb& output_box) const override {
@@ -126,6 +212,71 @@ public:
     }
 };
 
+/// @brief 在快门时间内匀速运动的球：time0 时球心位于 center0，time1 时位于 center1
+/// 按光线的时刻计算球心，配合 Camera::set_shutter 产生运动模糊
+class MovingSphere : public Hittable {
+public:
+    vec3 center0, center1;
+    double time0, time1;
+    double radius;
+    std::shared_ptr<Material> material;
+
+    /// @brief Instantiate a MovingSphere Instance
+    /// @param cent0 time0 时刻的球心
+    /// @param cent1 time1 时刻的球心
+    /// @param t0 起始时刻
+    /// @param t1 结束时刻
+    /// @param r 半径
+    /// @param mat 材质
+    MovingSphere(const vec3& cent0, const vec3& cent1, double t0, double t1, double r, const std::shared_ptr<Material>& mat) :
+        center0(cent0), center1(cent1), time0(t0), time1(t1), radius(r), material(mat) {}
+
+    /// @brief time 时刻的球心，超出 [time0, time1] 时沿同一速度外推
+    vec3 center(double time) const {
+        if (time1 == time0) return center0;
+        return center0 + (center1 - center0) * ((time - time0) / (time1 - time0));
+    }
+
+    virtual vec3 get_position() const override {
+        return center(time0);
+    }
+
+    virtual bool is_hit(const ray& r, hit& record, double t_min, double t_max) const override {
+        return deferred_hit(r, record, t_min, t_max);
+    }
+
+    virtual bool intersect(const ray& r, double t_min, double t_max, hit_candidate& candidate) const override {
+        double root;
+        if (!Sphere::solve_root(r, center(r.time), radius, t_min, t_max, root)) return false;
+
+        candidate = {root, this};
+        return true;
+    }
+
+    virtual void finalize_hit(const ray& r, const hit_candidate& candidate, hit& record) const override {
+        record.time = candidate.time;
+        record.position = r.origin + r.dir * candidate.time;
+        record.normal = (record.position - center(r.time)) * (1.0 / radius);
+
+        Sphere::get_sphere_uv(record.normal, record.uv);
+
+        record.material = material.get();
+    }
+
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        double root;
+        return Sphere::solve_root(r, center(r.time), radius, t_min, t_max, root);
+    }
+
+    /// @brief 覆盖整个 [t0, t1] 的包围盒：匀速运动时即为两端时刻包围盒的并集
+    virtual bool bounding_box(double t0, double t1, aabb& output_box) const override {
+        vec3 extent{std::fabs(radius), std::fabs(radius), std::fabs(radius)};
+        vec3 start = center(t0), end = center(t1);
+        output_box = surrounding_box(aabb(start - extent, start + extent), aabb(end - extent, end + extent));
+        return true;
+    }
+};
+
 class Plane : public Hittable {
 public:
     vec3 locate;
@@ -144,27 +295,53 @@ public:
     }
 
     virtual bool is_hit(const ray& r, hit& record, double t_min, double t_max) const override {
+        return deferred_hit(r, record, t_min, t_max);
+    }
+
+    /// @brief 光线与过 point、法线为 n 的平面求交，按标量类型 T 实例化 (PrecisionScene 使用 float 版本)
+    /// @param root 输出交点距离
+    /// @param epsilon 交点距离的下限，与 Sphere::solve_root 相同
+    template <typename T>
+    static bool solve_root(const ray_t<T>& r, const vec3_t<T>& point, const vec3_t<T>& n, T t_min, T t_max, T& root,
+        T epsilon = T(MINIMUM)) {
         // 几何逻辑：
         // 射线 P(t) = A + tb
         // 代入平面方程：(A + tb - P0) · N = 0
         // 解出 t = (P0 - A) · N / (b · N)
-        double denominator = r.dir.dot(normal);
+        T denominator = r.dir.dot(n);
+
+        if (std::abs(denominator) < T(1e-6)) return false;
 
-        if (std::abs(denominator) < 1e-6) return false;
+        root = (point - r.origin).dot(n) / denominator;
 
-        double root = (locate - r.origin).dot(normal) / denominator;
+        return root >= std::max(epsilon, t_min) && root <= t_max;
+    }
+
+    /// @brief 平面上的纹理坐标，每 2 个单位重复一次
+    template <typename T>
+    static vec2 surface_uv(const vec3_t<T>& position) {
+        return {position.x * 0.5, position.z * 0.5};
+    }
 
-        if (root < std::max(MINIMUM, t_min) || root > t_max) return false;
+    virtual bool intersect(const ray& r, double t_min, double t_max, hit_candidate& candidate) const override {
+        double root;
+        if (!solve_root(r, locate, normal, t_min, t_max, root)) return false;
 
-        record.time = root;
-        record.position = r.at(root);
+        candidate = {root, this};
+        return true;
+    }
+
+    virtual void finalize_hit(const ray& r, const hit_candidate& candidate, hit& record) const override {
+        record.time = candidate.time;
+        record.position = r.at(candidate.time);
         record.normal = normal;
         record.material = material.get();
+        record.uv = surface_uv(record.position);
+    }
 
-        record.uv.x = record.position.x * 0.5;
-        record.uv.y = record.position.z * 0.5;
-
-        return true;
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        double root;
+        return solve_root(r, locate, normal, t_min, t_max, root);
     }
 
     virtual bool bounding_box(double t0, double t1, aabb& output_box) const override {
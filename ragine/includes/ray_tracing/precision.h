@@ -0,0 +1,133 @@
+#pragma once
+
+#include "ragine.h"
+#include "object.h"
+#include "../bvh/bvh_build.h"
+#include "../bvh/linear_bvh.h"
+#include <cstdint>
+#include <vector>
+
+/// @brief 按标量类型 T 存放几何的场景，用于在同一场景上比较 float 与 double 的画质与速度
+/// 只收集 Sphere 与 Plane；BVH 就是引擎的 LinearBVH，遍历、包围盒测试与求交直接使用引擎的模板
+/// (traverse_bvh、node_slab_test、Sphere::solve_root、Plane::solve_root) 按 T 实例化，只有光线与几何数据换成 T
+/// 渲染用引擎的 ray_color<T>(r, scene, depth, true)：次级光线起点用 offset_ray_origin 按 ulp 挪到表面外侧，
+/// 求交区间与近根下限都从 0 开始，不使用 MINIMUM
+template <typename T>
+class PrecisionScene {
+public:
+    struct plane {
+        vec3_t<T> point;
+        vec3_t<T> normal;
+        Material* material;
+    };
+
+    /// @brief 最近交点：kind 为 0 表示球，1 表示平面，index 为对应数组中的下标
+    struct nearest_hit {
+        T time;
+        int kind;
+        uint32_t index;
+    };
+
+    LinearBVH bvh;                          // 只包含球，bvh.primitives 按叶子顺序排列
+    std::vector<vec3_t<T>> centers;         // 与 bvh.primitives 一一对应
+    std::vector<T> radius;
+    std::vector<Material*> sphere_material;
+    std::vector<plane> planes;
+
+    /// @brief 从 HittableList 收集球与平面，其他物体忽略
+    explicit PrecisionScene(const HittableList& list, const bvh_build_options& options = bvh_build_options()) {
+        // 平面的材质由原来的物体持有，这里只保留指针
+        owners = list.objects;
+
+        HittableList spheres;
+        size_t skipped = 0;
+        for (const auto& object : list.objects) {
+            if (auto sphere = std::dynamic_pointer_cast<Sphere>(object)) {
+                spheres.add(sphere);
+            } else if (auto p = std::dynamic_pointer_cast<Plane>(object)) {
+                planes.push_back({vec3_t<T>(p->locate), vec3_t<T>(p->normal), p->material.get()});
+            } else {
+                skipped++;
+            }
+        }
+        if (skipped > 0) {
+            std::cerr << "WARNING: PrecisionScene only supports Sphere and Plane, " << skipped << " objects were skipped.\n";
+        }
+        if (spheres.objects.empty()) return;
+
+        bvh = LinearBVH(spheres, 0.0, 0.0, options);
+        for (const auto& primitive : bvh.primitives) {
+            const Sphere& sphere = static_cast<const Sphere&>(*primitive);
+            centers.push_back(vec3_t<T>(sphere.center));
+            radius.push_back(T(sphere.radius));
+            sphere_material.push_back(sphere.material.get());
+        }
+    }
+
+    /// @brief 求 [t_min, t_max] 内的最近交点；起点已经挪离表面，球与平面的下限都不再使用 MINIMUM
+    bool nearest(const ray_t<T>& r, T t_min, T t_max, nearest_hit& result) const {
+        T closest = t_max;
+        bool found = false;
+
+        for (uint32_t i = 0; i < planes.size(); i++) {
+            T root;
+            if (Plane::solve_root(r, planes[i].point, planes[i].normal, t_min, closest, root, T(0))) {
+                closest = root;
+                result = {root, 1, i};
+                found = true;
+            }
+        }
+
+        if (bvh.nodes.empty()) return found;
+
+        vec3_t<T> inv_dir{T(1) / r.dir.x, T(1) / r.dir.y, T(1) / r.dir.z};
+        int dir_is_neg[3] = {inv_dir.x < 0, inv_dir.y < 0, inv_dir.z < 0};
+        traverse_bvh(bvh.nodes.data(), dir_is_neg,
+            [&](const linear_bvh_node& node) {
+                return node_slab_test(node, r, inv_dir, dir_is_neg, t_min, closest);
+            },
+            [&](const linear_bvh_node& node) {
+                RAGINE_BVH_COUNT(primitive_tests, node.count);
+                for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                    T root;
+                    if (Sphere::solve_root(r, centers[i], radius[i], t_min, closest, root, T(0))) {
+                        closest = root;
+                        result = {root, 0, i};
+                        found = true;
+                    }
+                }
+                return false;
+            });
+        return found;
+    }
+
+    /// @brief 供 ray_color<T> 调用的求交接口，交点属性按 T 计算
+    bool is_hit(const ray_t<T>& r, hit_t<T>& record, T t_min, T t_max) const {
+        nearest_hit found;
+        if (!nearest(r, t_min, t_max, found)) return false;
+
+        vec3_t<T> position = r.at(found.time);
+        if (found.kind == 0) {
+            // 交点重新投影回球面，消除 t 的舍入误差沿光线方向的放大
+            vec3_t<T> center = centers[found.index];
+            vec3_t<T> offset = position - center;
+            T rad = radius[found.index];
+            position = center + offset * (std::fabs(rad) / offset.length());
+            record.normal = (position - center) * (T(1) / rad);
+            record.material = sphere_material[found.index];
+            Sphere::get_sphere_uv(vec3(record.normal), record.uv);
+        } else {
+            record.normal = planes[found.index].normal;
+            record.material = planes[found.index].material;
+            record.uv = Plane::surface_uv(position);
+        }
+        record.time = found.time;
+        record.position = position;
+        return true;
+    }
+
+    size_t node_bytes() const { return bvh.nodes.size() * sizeof(linear_bvh_node); }
+
+private:
+    std::vector<std::shared_ptr<Hittable>> owners;
+};
@@ -1,5 +1,41 @@
 #pragma once
 
 #include "ragine.h"
+#include <type_traits>
 
-vec3 ray_color(const ray& r, const Hittable& world, int depth);
\ No newline at end of file
+/// @brief 路径追踪，按标量类型 T 实例化：World 需要提供 is_hit(const ray_t<T>&, hit_t<T>&, T t_min, T t_max)
+/// 引擎 (robust 为 false) 用 t_min = MINIMUM 排除自相交；robust 为 true 时次级光线起点用 offset_ray_origin
+/// 挪到表面外侧，求交从 t = 0 开始 (PrecisionScene)
+/// 材质只有 double 接口，其他精度的光线与交点在调用 scatter 前转换为 double
+template <typename T, typename World>
+vec3 ray_color(const ray_t<T>& r, const World& world, int depth, bool robust = false) {
+    if (depth < 1) return {0.0, 0.0, 0.0};
+
+    hit_t<T> record;
+    if (world.is_hit(r, record, robust ? T(0) : T(MINIMUM), T(INFINITY))) {
+        vec3 attenuation;
+        ray out_ray;
+        bool scattered;
+        if constexpr (std::is_same_v<T, double>) {
+            scattered = record.material->scatter(r, record, attenuation, out_ray);
+        } else {
+            ray in_ray{vec3(r.origin), vec3(r.dir), r.time};
+            hit record_double{vec3(record.position), vec3(record.normal), record.material, double(record.time), record.uv};
+            scattered = record.material->scatter(in_ray, record_double, attenuation, out_ray);
+        }
+        if (scattered) {
+            ray_t<T> next{vec3_t<T>(out_ray.origin), vec3_t<T>(out_ray.dir), out_ray.time};
+            if (robust) {
+                // 法线翻到出射方向一侧：反射沿外法线挪开，折射挪到表面内侧
+                vec3_t<T> side = next.dir.dot(record.normal) < 0 ? record.normal * T(-1) : record.normal;
+                next.origin = offset_ray_origin(record.position, side);
+            }
+            return ray_color(next, world, depth - 1, robust) * attenuation;
+        }
+        return {0.0, 0.0, 0.0};
+    } 
+
+    vec3 unit_direction = vec3(r.dir).normalize();
+    double t = 0.5 * (unit_direction.y + 1.0);
+    return vec3{1.0, 1.0, 1.0} * (1.0 - t) + vec3{0.5, 0.7, 1.0} * t;
+}
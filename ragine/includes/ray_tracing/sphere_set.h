@@ -0,0 +1,145 @@
+#pragma once
+
+#include "ragine.h"
+#include "object.h"
+#include "../bvh/bvh_build.h"
+#include "../components/cpu_dispatch.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/// @brief 一批球体，球心、半径与材质编号按 SoA 形式存放，一条 SIMD 指令同时与多个球求交
+/// 求交由运行时选择的核心完成 (cpu_kernels::sphere_nearest)：AVX-512 每次 8 个、AVX2 每次 4 个、SSE 每次 2 个 (double 精度)
+/// 求交结果与逐个调用 Sphere::is_hit 相同，但省去了每个球一次虚函数调用与一个独立的堆对象
+/// 既可以单独作为物体列表使用，也可以用 clusters 切成小批作为 BVH 的叶子
+class SphereSet : public Hittable {
+public:
+    std::vector<double> center_x, center_y, center_z;
+    std::vector<double> radius;
+    std::vector<uint32_t> material_id;
+    std::vector<std::shared_ptr<Material>> materials;
+    aabb box = empty_box();
+
+    SphereSet() {}
+
+    /// @brief 收集 list 中的所有 Sphere，其他物体忽略
+    explicit SphereSet(const HittableList& list) {
+        for (const auto& object : list.objects) {
+            if (auto sphere = std::dynamic_pointer_cast<Sphere>(object)) add(sphere->center, sphere->radius, sphere->material);
+        }
+    }
+
+    void add(const vec3& center, double r, const std::shared_ptr<Material>& material) {
+        center_x.push_back(center.x);
+        center_y.push_back(center.y);
+        center_z.push_back(center.z);
+        radius.push_back(r);
+
+        auto found = material_lookup.find(material.get());
+        if (found == material_lookup.end()) {
+            found = material_lookup.emplace(material.get(), (uint32_t)materials.size()).first;
+            materials.push_back(material);
+        }
+        material_id.push_back(found->second);
+
+        double extent = std::fabs(r);
+        box = surrounding_box(box, aabb(center - vec3{extent, extent, extent}, center + vec3{extent, extent, extent}));
+    }
+
+    /// @brief 当前指令集级别下一条 SIMD 指令同时求交的球数
+    static size_t lanes() { return active_kernels().double_lanes; }
+
+    size_t size() const { return radius.size(); }
+
+    /// @brief 用 SAH 构建一棵叶子不超过 cluster_size 个球的 BVH，每个叶子切成一批，同一批中的球在空间上相邻
+    /// 把结果交给 LinearBVH (max_leaf_size = 1) 即得到以 SphereSet 为叶子的 BVH
+    std::vector<std::shared_ptr<Hittable>> clusters(size_t cluster_size = 8) const {
+        std::vector<bvh_primitive> prims(size());
+        for (size_t i = 0; i < size(); i++) {
+            double extent = std::fabs(radius[i]);
+            vec3 center{center_x[i], center_y[i], center_z[i]};
+            prims[i] = {aabb(center - vec3{extent, extent, extent}, center + vec3{extent, extent, extent}), center, i};
+        }
+
+        // 一次 SIMD 求交覆盖 lanes 个球，按单个球计的求交代价相应降低，SAH 才会愿意生成更大的叶子
+        bvh_build_options options;
+        options.max_leaf_size = (int)cluster_size;
+        options.intersect_cost = 0.5 / lanes();
+        bvh_build_tree tree = build_bvh(std::move(prims), options);
+
+        std::vector<std::shared_ptr<Hittable>> result;
+        if (tree.empty()) return result;
+
+        std::vector<uint32_t> pending{0};
+        while (!pending.empty()) {
+            const bvh_build_node& node = tree.nodes[pending.back()];
+            pending.pop_back();
+            if (node.count == 0) {
+                pending.push_back(node.child[1]);
+                pending.push_back(node.child[0]);
+                continue;
+            }
+
+            auto cluster = std::make_shared<SphereSet>();
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                size_t index = tree.prims[i].index;
+                cluster->add(vec3{center_x[index], center_y[index], center_z[index]}, radius[index], materials[material_id[index]]);
+            }
+            result.push_back(cluster);
+        }
+        return result;
+    }
+
+    virtual bool is_hit(const ray& r, hit& record, double t_min, double t_max) const override {
+        return deferred_hit(r, record, t_min, t_max);
+    }
+
+    virtual bool intersect(const ray& r, double t_min, double t_max, hit_candidate& candidate) const override {
+        double closest = t_max;
+        size_t index = nearest(r, t_min, closest);
+        if (index == SIZE_MAX) return false;
+
+        candidate = {closest, this, (uint32_t)index};
+        return true;
+    }
+
+    virtual void finalize_hit(const ray& r, const hit_candidate& candidate, hit& record) const override {
+        size_t index = candidate.primitive;
+        vec3 center{center_x[index], center_y[index], center_z[index]};
+        record.time = candidate.time;
+        record.position = r.origin + r.dir * candidate.time;
+        record.normal = (record.position - center) * (1.0 / radius[index]);
+        Sphere::get_sphere_uv(record.normal, record.uv);
+        record.material = materials[material_id[index]].get();
+    }
+
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        double closest = t_max;
+        return nearest(r, t_min, closest, true) != SIZE_MAX;
+    }
+
+    virtual bool bounding_box(double t0, double t1, aabb& output_box) const override {
+        if (radius.empty()) return false;
+        output_box = box;
+        return true;
+    }
+
+    virtual vec3 get_position() const override {
+        return (box.minimum + box.maximum) * 0.5;
+    }
+
+private:
+    std::unordered_map<const Material*, uint32_t> material_lookup;
+
+    /// @brief 与 Sphere::is_hit 相同的求根与区间判定：先取近根，不在区间内再取远根
+    /// @return 最近交点的下标，没有交点时返回 SIZE_MAX；closest 更新为交点距离
+    size_t nearest(const ray& r, double t_min, double& closest, bool any_hit = false) const {
+        if (radius.empty()) return SIZE_MAX;
+        const double origin[3] = {r.origin.x, r.origin.y, r.origin.z};
+        const double dir[3] = {r.dir.x, r.dir.y, r.dir.z};
+        return active_kernels().sphere_nearest(center_x.data(), center_y.data(), center_z.data(), radius.data(), size(),
+            origin, dir, std::max(MINIMUM, t_min), std::min(0.001, t_min), closest, any_hit);
+    }
+};
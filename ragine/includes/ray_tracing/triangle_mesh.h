@@ -0,0 +1,283 @@
+#pragma once
+
+#include "ragine.h"
+#include "object.h"
+#include "../bvh/bvh_build.h"
+#include "../bvh/linear_bvh.h"
+#include "../components/cpu_dispatch.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/// @brief 三角形一个角引用的顶点属性下标，法线与纹理坐标缺省时为 none
+struct mesh_vertex {
+    static constexpr uint32_t none = UINT32_MAX;
+
+    uint32_t position;
+    uint32_t normal = none;
+    uint32_t uv = none;
+};
+
+/// @brief 带索引的三角形网格：所有三角形共享同一组顶点位置、法线与纹理坐标，indices 中每 3 个为一个三角形
+/// 填好数据后调用 build：三角形按 BVH 叶子重排，每个叶子成为一批，批内的三角形一起求交
+/// 网格本身即是一个带 BVH 的物体，可以直接放进场景或作为 Instance 的几何体
+class TriangleMesh : public Hittable {
+public:
+    std::vector<vec3> positions;
+    std::vector<vec3> normals;
+    std::vector<vec2> uvs;
+    std::vector<mesh_vertex> indices;
+    std::shared_ptr<Material> material;
+
+    /// @brief 一批三角形数量的上限，批内求交结果放在栈上
+    static constexpr size_t max_batch_size = 16;
+
+    explicit TriangleMesh(const std::shared_ptr<Material>& mat = nullptr) : material(mat) {}
+
+    // 每一批都引用网格内的数组，复制后引用会失效
+    TriangleMesh(const TriangleMesh&) = delete;
+    TriangleMesh& operator=(const TriangleMesh&) = delete;
+
+    size_t triangle_count() const { return indices.size() / 3; }
+
+    void add_triangle(const mesh_vertex& a, const mesh_vertex& b, const mesh_vertex& c) {
+        indices.push_back(a);
+        indices.push_back(b);
+        indices.push_back(c);
+    }
+
+    /// @brief 构建 BVH：叶子不超过 batch_size 个三角形，三角形按叶子顺序重排，顶点坐标按批展开为 SoA
+    /// @param options 三角形级 BVH 的构建参数，max_leaf_size 会被限制在 max_batch_size 以内
+    void build(bvh_build_options options = default_build_options()) {
+        size_t count = triangle_count();
+        std::vector<bvh_primitive> prims(count);
+
+        #pragma omp parallel for schedule(static) if (count >= options.parallel_threshold)
+        for (long long i = 0; i < (long long)count; i++) {
+            aabb box = empty_box();
+            for (int k = 0; k < 3; k++) {
+                const vec3& p = positions[indices[3 * i + k].position];
+                box = surrounding_box(box, aabb(p, p));
+            }
+            // 与坐标轴平行的三角形包围盒厚度为 0，稍微加厚，避免包围盒测试的舍入误差漏掉交点
+            double pad = 1e-9 * (1.0 + std::max({std::fabs(box.minimum.x), std::fabs(box.minimum.y), std::fabs(box.minimum.z),
+                std::fabs(box.maximum.x), std::fabs(box.maximum.y), std::fabs(box.maximum.z)}));
+            box = aabb(box.minimum - vec3{pad, pad, pad}, box.maximum + vec3{pad, pad, pad});
+            prims[i] = {box, box.centroid(), (size_t)i};
+        }
+
+        options.max_leaf_size = std::clamp(options.max_leaf_size, 1, (int)max_batch_size);
+        bvh_build_tree tree = build_bvh(std::move(prims), options);
+        batches.clear();
+        accel.reset();
+        if (tree.empty()) return;
+
+        // 每个叶子替换为一批三角形，树的形状保持不变，直接交给 LinearBVH 扁平化
+        std::vector<mesh_vertex> ordered(indices.size());
+        std::vector<bvh_primitive> leaves;
+        #pragma omp parallel for schedule(static) if (count >= options.parallel_threshold)
+        for (long long i = 0; i < (long long)count; i++) {
+            size_t source = tree.prims[i].index;
+            for (int k = 0; k < 3; k++) ordered[3 * i + k] = indices[3 * source + k];
+        }
+        indices = std::move(ordered);
+
+        for (bvh_build_node& node : tree.nodes) {
+            if (node.count == 0) continue;
+            aabb box = primitive_bounds(tree.prims, node.first, node.first + node.count);
+            batches.push_back(std::make_shared<TriangleBatch>(this, node.first, node.count, box));
+            leaves.push_back({box, box.centroid(), leaves.size()});
+            node.first = (uint32_t)(leaves.size() - 1);
+            node.count = 1;
+        }
+        tree.prims = std::move(leaves);
+
+        for (int corner = 0; corner < 3; corner++) {
+            for (int axis = 0; axis < 3; axis++) vertex[corner][axis].resize(count);
+        }
+        #pragma omp parallel for schedule(static) if (count >= options.parallel_threshold)
+        for (long long i = 0; i < (long long)count; i++) {
+            for (int corner = 0; corner < 3; corner++) {
+                const vec3& p = positions[indices[3 * i + corner].position];
+                for (int axis = 0; axis < 3; axis++) vertex[corner][axis][i] = p[axis];
+            }
+        }
+
+        accel = std::make_shared<LinearBVH>(batches, tree, options.layout);
+    }
+
+    /// @brief 三角形级 BVH 的默认参数：批内的三角形由 cpu_kernels::triangle_test 一起求交，单个三角形的求交代价按一半计
+    static bvh_build_options default_build_options() {
+        bvh_build_options options;
+        options.max_leaf_size = 8;
+        options.intersect_cost = 0.5;
+        return options;
+    }
+
+    bool is_built() const { return accel != nullptr; }
+
+    virtual bool is_hit(const ray& r, hit& record, double t_min, double t_max) const override {
+        return deferred_hit(r, record, t_min, t_max);
+    }
+
+    virtual bool intersect(const ray& r, double t_min, double t_max, hit_candidate& candidate) const override {
+        return accel && accel->intersect(r, t_min, t_max, candidate);
+    }
+
+    virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+        return accel && accel->is_occluded(r, t_min, t_max);
+    }
+
+    virtual bool bounding_box(double t0, double t1, aabb& output_box) const override {
+        return accel && accel->bounding_box(t0, t1, output_box);
+    }
+
+    virtual vec3 get_position() const override {
+        aabb box;
+        if (!bounding_box(0, 0, box)) return {0.0, 0.0, 0.0};
+        return (box.minimum + box.maximum) * 0.5;
+    }
+
+private:
+    /// @brief 剪切变换后三角形三条边的有向面积与交点距离 (Woop et al. 2013)
+    /// 共享一条边的两个三角形对该边计算出完全相同的值，光线不会从相邻三角形的缝隙中漏过
+    struct watertight_ray {
+        int kx, ky, kz;
+        double sx, sy, sz;
+        double ox, oy, oz;
+
+        explicit watertight_ray(const ray& r) {
+            vec3 abs_dir{std::fabs(r.dir.x), std::fabs(r.dir.y), std::fabs(r.dir.z)};
+            kz = abs_dir.x > abs_dir.y ? (abs_dir.x > abs_dir.z ? 0 : 2) : (abs_dir.y > abs_dir.z ? 1 : 2);
+            kx = (kz + 1) % 3;
+            ky = (kx + 1) % 3;
+            // 保持三角形的环绕方向不因 kz 轴取反而翻转
+            if (r.dir[kz] < 0) std::swap(kx, ky);
+
+            sx = r.dir[kx] / r.dir[kz];
+            sy = r.dir[ky] / r.dir[kz];
+            sz = 1.0 / r.dir[kz];
+            ox = r.origin[kx];
+            oy = r.origin[ky];
+            oz = r.origin[kz];
+        }
+    };
+
+    /// @brief BVH 的一个叶子：网格中下标 [first, first + count) 的三角形
+    class TriangleBatch : public Hittable {
+    public:
+        TriangleBatch(const TriangleMesh* owner, uint32_t first_index, uint32_t triangle_count, const aabb& bounds)
+            : mesh(owner), first(first_index), count(triangle_count), box(bounds) {}
+
+        virtual bool is_hit(const ray& r, hit& record, double t_min, double t_max) const override {
+            return deferred_hit(r, record, t_min, t_max);
+        }
+
+        /// @brief 记录最近三角形的下标与后两个顶点的重心坐标，法线与纹理坐标的插值留给 finalize_hit
+        virtual bool intersect(const ray& r, double t_min, double t_max, hit_candidate& candidate) const override {
+            double closest = t_max;
+            double u, v, w;
+            uint32_t index = nearest(r, t_min, closest, u, v, w, false);
+            if (index == UINT32_MAX) return false;
+
+            candidate = {closest, this, index, v, w};
+            return true;
+        }
+
+        virtual void finalize_hit(const ray& r, const hit_candidate& candidate, hit& record) const override {
+            record.time = candidate.time;
+            record.position = r.at(candidate.time);
+            mesh->interpolate(first + candidate.primitive, 1.0 - candidate.u - candidate.v, candidate.u, candidate.v, record);
+        }
+
+        virtual bool is_occluded(const ray& r, double t_min, double t_max) const override {
+            double closest = t_max;
+            double u, v, w;
+            return nearest(r, t_min, closest, u, v, w, true) != UINT32_MAX;
+        }
+
+        virtual bool bounding_box(double t0, double t1, aabb& output_box) const override {
+            output_box = box;
+            return true;
+        }
+
+        virtual vec3 get_position() const override {
+            return (box.minimum + box.maximum) * 0.5;
+        }
+
+    private:
+        const TriangleMesh* mesh;
+        uint32_t first, count;
+        aabb box;
+
+        /// @brief 批内所有三角形一起做 watertight 测试，结果先写入栈上数组，再选出最近的一个
+        /// @return 批内下标，没有交点时返回 UINT32_MAX；u v w 为三个顶点的重心坐标
+        uint32_t nearest(const ray& r, double t_min, double& closest, double& u, double& v, double& w, bool any_hit) const {
+            watertight_ray wr(r);
+            const double *ax = &mesh->vertex[0][wr.kx][first], *ay = &mesh->vertex[0][wr.ky][first], *az = &mesh->vertex[0][wr.kz][first];
+            const double *bx = &mesh->vertex[1][wr.kx][first], *by = &mesh->vertex[1][wr.ky][first], *bz = &mesh->vertex[1][wr.kz][first];
+            const double *cx = &mesh->vertex[2][wr.kx][first], *cy = &mesh->vertex[2][wr.ky][first], *cz = &mesh->vertex[2][wr.kz][first];
+            double near_min = std::max(MINIMUM, t_min), far_max = closest;
+            double lane_t[max_batch_size];
+
+            // 批内所有三角形由运行时选择的核心一起测试，循环按当前指令集的向量宽度展开
+            const double* const vertex[3][3] = {{ax, ay, az}, {bx, by, bz}, {cx, cy, cz}};
+            const double origin[3] = {wr.ox, wr.oy, wr.oz};
+            const double shear[3] = {wr.sx, wr.sy, wr.sz};
+            active_kernels().triangle_test(vertex, count, origin, shear, near_min, far_max, lane_t);
+
+            uint32_t best = UINT32_MAX;
+            for (uint32_t i = 0; i < count; i++) {
+                if (lane_t[i] >= 0.0 && (best == UINT32_MAX || lane_t[i] < closest)) {
+                    closest = lane_t[i];
+                    best = i;
+                    if (any_hit) return best;
+                }
+            }
+            if (best == UINT32_MAX) return best;
+
+            // 只为最近的三角形重新计算重心坐标，与 triangle_test 中的计算完全相同
+            double a_z = az[best] - wr.oz, b_z = bz[best] - wr.oz, c_z = cz[best] - wr.oz;
+            double a_x = ax[best] - wr.ox - wr.sx * a_z, a_y = ay[best] - wr.oy - wr.sy * a_z;
+            double b_x = bx[best] - wr.ox - wr.sx * b_z, b_y = by[best] - wr.oy - wr.sy * b_z;
+            double c_x = cx[best] - wr.ox - wr.sx * c_z, c_y = cy[best] - wr.oy - wr.sy * c_z;
+            double e0 = c_x * b_y - c_y * b_x;
+            double e1 = a_x * c_y - a_y * c_x;
+            double e2 = b_x * a_y - b_y * a_x;
+            double inv_det = 1.0 / (e0 + e1 + e2);
+            u = e0 * inv_det;
+            v = e1 * inv_det;
+            w = e2 * inv_det;
+            return best;
+        }
+    };
+
+    std::vector<std::shared_ptr<Hittable>> batches;
+    std::shared_ptr<LinearBVH> accel;
+    std::vector<double> vertex[3][3];   // [顶点][轴]，按三角形顺序展开的顶点坐标
+
+    /// @brief 由重心坐标插值法线与纹理坐标；没有顶点法线时使用几何法线，没有纹理坐标时直接用重心坐标
+    void interpolate(size_t triangle, double u, double v, double w, hit& record) const {
+        const mesh_vertex& a = indices[3 * triangle];
+        const mesh_vertex& b = indices[3 * triangle + 1];
+        const mesh_vertex& c = indices[3 * triangle + 2];
+
+        if (a.normal != mesh_vertex::none && b.normal != mesh_vertex::none && c.normal != mesh_vertex::none) {
+            record.normal = (normals[a.normal] * u + normals[b.normal] * v + normals[c.normal] * w).normalize();
+        } else {
+            const vec3& p0 = positions[a.position];
+            record.normal = (positions[b.position] - p0).cross(positions[c.position] - p0).normalize();
+        }
+
+        if (a.uv != mesh_vertex::none && b.uv != mesh_vertex::none && c.uv != mesh_vertex::none) {
+            record.uv.x = uvs[a.uv].x * u + uvs[b.uv].x * v + uvs[c.uv].x * w;
+            record.uv.y = uvs[a.uv].y * u + uvs[b.uv].y * v + uvs[c.uv].y * w;
+        } else {
+            record.uv.x = v;
+            record.uv.y = w;
+        }
+
+        record.material = material.get();
+    }
+};
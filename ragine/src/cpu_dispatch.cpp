@@ -0,0 +1,124 @@
+#include "ragine.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// 热点核心按指令集级别各编译一份：每份位于自己的 #pragma GCC target 区域与命名空间内，
+// 不依赖 -march 等编译选项，同一个可执行文件可以在不同代的 CPU 上使用各自能执行的最快版本
+#if defined(__GNUC__) && defined(__x86_64__)
+#define RAGINE_CPU_DISPATCH 1
+#define RAGINE_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace kernels_baseline {
+#define RAGINE_KERNEL_LEVEL 0
+#include "cpu_kernels.h"
+#undef RAGINE_KERNEL_LEVEL
+}
+
+#if defined(RAGINE_CPU_DISPATCH)
+// 不开启 FMA：乘加融合会改变舍入，各级别的结果就不再逐位相同
+#pragma GCC push_options
+#pragma GCC target("sse4.2,popcnt")
+namespace kernels_sse42 {
+#define RAGINE_KERNEL_LEVEL 1
+#include "cpu_kernels.h"
+#undef RAGINE_KERNEL_LEVEL
+}
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2,popcnt")
+namespace kernels_avx2 {
+#define RAGINE_KERNEL_LEVEL 2
+#include "cpu_kernels.h"
+#undef RAGINE_KERNEL_LEVEL
+}
+#pragma GCC pop_options
+
+// AVX-512F 本身包含 FMA 指令，这一级别另外关闭 fp-contract
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512vl,avx512dq,avx512bw,avx2,popcnt")
+#pragma GCC optimize("fp-contract=off")
+namespace kernels_avx512 {
+#define RAGINE_KERNEL_LEVEL 3
+#include "cpu_kernels.h"
+#undef RAGINE_KERNEL_LEVEL
+}
+#pragma GCC pop_options
+#endif
+
+const char* cpu_isa_name(cpu_isa isa) {
+    switch (isa) {
+        case cpu_isa::baseline: return "baseline";
+        case cpu_isa::sse42: return "sse4.2";
+        case cpu_isa::avx2: return "avx2";
+        case cpu_isa::avx512: return "avx512";
+    }
+    return "unknown";
+}
+
+cpu_isa detect_cpu_isa() {
+#if defined(RAGINE_CPU_DISPATCH)
+    // __builtin_cpu_supports 同时检查了操作系统是否保存对应的寄存器状态
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+        __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512bw")) {
+        return cpu_isa::avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) return cpu_isa::avx2;
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) return cpu_isa::sse42;
+#endif
+    return cpu_isa::baseline;
+}
+
+/// @brief 指定级别的核心；该级别没有编译时 (非 x86 构建) 返回 baseline
+static const cpu_kernels* kernels_for(cpu_isa isa) {
+#if defined(RAGINE_CPU_DISPATCH)
+    switch (isa) {
+        case cpu_isa::avx512: return &kernels_avx512::table;
+        case cpu_isa::avx2: return &kernels_avx2::table;
+        case cpu_isa::sse42: return &kernels_sse42::table;
+        default: break;
+    }
+#endif
+    return &kernels_baseline::table;
+}
+
+const cpu_kernels* select_cpu_kernels() {
+    cpu_isa detected = detect_cpu_isa();
+    cpu_isa chosen = detected;
+    const char* forced = std::getenv("RAGINE_ISA");
+
+    if (forced && *forced) {
+        std::string name = forced;
+        bool known = false;
+        for (int level = 0; level <= (int)cpu_isa::avx512; level++) {
+            if (name == cpu_isa_name((cpu_isa)level)) {
+                chosen = (cpu_isa)level;
+                known = true;
+            }
+        }
+        if (!known) {
+            std::cerr << "WARNING: Unknown RAGINE_ISA '" << name << "', using " << cpu_isa_name(detected) << ".\n";
+        } else if (chosen > detected) {
+            std::cerr << "WARNING: RAGINE_ISA=" << name << " is not supported by this CPU, using "
+                      << cpu_isa_name(detected) << ".\n";
+            chosen = detected;
+        }
+    }
+
+    const cpu_kernels* kernels = kernels_for(chosen);
+    std::cout << "CPU dispatch: " << cpu_isa_name(kernels->isa) << " (detected " << cpu_isa_name(detected)
+              << (kernels->isa != detected ? ", forced by RAGINE_ISA" : "") << ")" << std::endl;
+    return kernels;
+}
+
+cpu_isa set_cpu_isa(cpu_isa isa) {
+    const cpu_kernels* kernels = kernels_for(std::min(isa, detect_cpu_isa()));
+    active_kernel_slot() = kernels;
+    return kernels->isa;
+}
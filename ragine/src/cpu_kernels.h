@@ -0,0 +1,303 @@
+// 热点核心的实现，由 cpu_dispatch.cpp 在每个指令集级别的 #pragma GCC target 区域内各包含一次，因此没有 include guard
+// 包含前需要定义 RAGINE_KERNEL_LEVEL (cpu_isa 的数值)；x86 构建还需定义 RAGINE_KERNEL_X86，否则只编译标量版本
+// 数值计算的顺序与标量代码保持一致，各个级别得到的交点距离与像素值逐位相同
+
+static uint32_t slab_test8(const float bounds_min[3][8], const float bounds_max[3][8], const float org_min[3],
+    const float org_max[3], const float inv_dir[3], float t_min, float t_max, float t_near[8]) {
+#if defined(RAGINE_KERNEL_X86) && RAGINE_KERNEL_LEVEL >= 2
+    __m256 tn = _mm256_set1_ps(t_min);
+    __m256 tf = _mm256_set1_ps(t_max);
+    for (int axis = 0; axis < 3; axis++) {
+        __m256 o_min = _mm256_set1_ps(org_min[axis]);
+        __m256 o_max = _mm256_set1_ps(org_max[axis]);
+        __m256 inv = _mm256_set1_ps(inv_dir[axis]);
+        __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(bounds_min[axis]), o_min), inv);
+        __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(bounds_max[axis]), o_max), inv);
+        tn = _mm256_max_ps(tn, _mm256_min_ps(t0, t1));
+        tf = _mm256_min_ps(tf, _mm256_max_ps(t0, t1));
+    }
+    _mm256_storeu_ps(t_near, tn);
+    return (uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(tn, tf, _CMP_LE_OQ));
+#elif defined(RAGINE_KERNEL_X86)
+    uint32_t mask = 0;
+    for (int lane = 0; lane < 8; lane += 4) {
+        __m128 tn = _mm_set1_ps(t_min);
+        __m128 tf = _mm_set1_ps(t_max);
+        for (int axis = 0; axis < 3; axis++) {
+            __m128 o_min = _mm_set1_ps(org_min[axis]);
+            __m128 o_max = _mm_set1_ps(org_max[axis]);
+            __m128 inv = _mm_set1_ps(inv_dir[axis]);
+            __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bounds_min[axis] + lane), o_min), inv);
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bounds_max[axis] + lane), o_max), inv);
+            tn = _mm_max_ps(tn, _mm_min_ps(t0, t1));
+            tf = _mm_min_ps(tf, _mm_max_ps(t0, t1));
+        }
+        _mm_storeu_ps(t_near + lane, tn);
+        mask |= (uint32_t)_mm_movemask_ps(_mm_cmple_ps(tn, tf)) << lane;
+    }
+    return mask;
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < 8; i++) {
+        float tn = t_min, tf = t_max;
+        for (int axis = 0; axis < 3; axis++) {
+            float t0 = (bounds_min[axis][i] - org_min[axis]) * inv_dir[axis];
+            float t1 = (bounds_max[axis][i] - org_max[axis]) * inv_dir[axis];
+            tn = std::max(tn, std::min(t0, t1));
+            tf = std::min(tf, std::max(t0, t1));
+        }
+        t_near[i] = tn;
+        if (tn <= tf) mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+static uint32_t quantized_slab_test8(const uint8_t q_min[3][8], const uint8_t q_max[3][8], const float s[3],
+    const float o_min[3], const float o_max[3], float t_min, float t_max, float t_near[8]) {
+#if defined(RAGINE_KERNEL_X86) && RAGINE_KERNEL_LEVEL >= 2
+    __m256 tn = _mm256_set1_ps(t_min);
+    __m256 tf = _mm256_set1_ps(t_max);
+    for (int axis = 0; axis < 3; axis++) {
+        __m256 qlo = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)q_min[axis])));
+        __m256 qhi = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)q_max[axis])));
+        __m256 sa = _mm256_set1_ps(s[axis]);
+        __m256 t0 = _mm256_add_ps(_mm256_mul_ps(qlo, sa), _mm256_set1_ps(o_min[axis]));
+        __m256 t1 = _mm256_add_ps(_mm256_mul_ps(qhi, sa), _mm256_set1_ps(o_max[axis]));
+        tn = _mm256_max_ps(tn, _mm256_min_ps(t0, t1));
+        tf = _mm256_min_ps(tf, _mm256_max_ps(t0, t1));
+    }
+    _mm256_storeu_ps(t_near, tn);
+    return (uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(tn, tf, _CMP_LE_OQ));
+#elif defined(RAGINE_KERNEL_X86)
+    __m128 tn[2] = {_mm_set1_ps(t_min), _mm_set1_ps(t_min)};
+    __m128 tf[2] = {_mm_set1_ps(t_max), _mm_set1_ps(t_max)};
+    for (int axis = 0; axis < 3; axis++) {
+        __m128i lo8 = _mm_loadl_epi64((const __m128i*)q_min[axis]);
+        __m128i hi8 = _mm_loadl_epi64((const __m128i*)q_max[axis]);
+        __m128 sa = _mm_set1_ps(s[axis]);
+        __m128 oa_min = _mm_set1_ps(o_min[axis]);
+        __m128 oa_max = _mm_set1_ps(o_max[axis]);
+        for (int half = 0; half < 2; half++) {
+#if RAGINE_KERNEL_LEVEL >= 1
+            // SSE4.1 可以直接把 8 位零扩展到 32 位
+            __m128i lo32 = _mm_cvtepu8_epi32(half ? _mm_srli_si128(lo8, 4) : lo8);
+            __m128i hi32 = _mm_cvtepu8_epi32(half ? _mm_srli_si128(hi8, 4) : hi8);
+#else
+            // SSE2 没有直接的 8 位到 32 位扩展指令，与 0 交错两次完成零扩展
+            const __m128i zero = _mm_setzero_si128();
+            __m128i lo16 = _mm_unpacklo_epi8(lo8, zero), hi16 = _mm_unpacklo_epi8(hi8, zero);
+            __m128i lo32 = half ? _mm_unpackhi_epi16(lo16, zero) : _mm_unpacklo_epi16(lo16, zero);
+            __m128i hi32 = half ? _mm_unpackhi_epi16(hi16, zero) : _mm_unpacklo_epi16(hi16, zero);
+#endif
+            __m128 t0 = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(lo32), sa), oa_min);
+            __m128 t1 = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(hi32), sa), oa_max);
+            tn[half] = _mm_max_ps(tn[half], _mm_min_ps(t0, t1));
+            tf[half] = _mm_min_ps(tf[half], _mm_max_ps(t0, t1));
+        }
+    }
+    _mm_storeu_ps(t_near, tn[0]);
+    _mm_storeu_ps(t_near + 4, tn[1]);
+    return (uint32_t)_mm_movemask_ps(_mm_cmple_ps(tn[0], tf[0]))
+         | (uint32_t)_mm_movemask_ps(_mm_cmple_ps(tn[1], tf[1])) << 4;
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < 8; i++) {
+        float tn = t_min, tf = t_max;
+        for (int axis = 0; axis < 3; axis++) {
+            float t0 = q_min[axis][i] * s[axis] + o_min[axis];
+            float t1 = q_max[axis][i] * s[axis] + o_max[axis];
+            tn = std::max(tn, std::min(t0, t1));
+            tf = std::min(tf, std::max(t0, t1));
+        }
+        t_near[i] = tn;
+        if (tn <= tf) mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+#if defined(RAGINE_KERNEL_X86)
+/// @brief sphere_nearest 使用的向量操作，每个级别使用各自宽度的寄存器
+struct double_simd {
+#if RAGINE_KERNEL_LEVEL >= 3
+    using vec = __m512d;
+    using mask = __mmask8;
+    static vec set1(double x) { return _mm512_set1_pd(x); }
+    static vec load(const double* p) { return _mm512_loadu_pd(p); }
+    static mask ge(vec x, vec y) { return _mm512_cmp_pd_mask(x, y, _CMP_GE_OQ); }
+    static mask le(vec x, vec y) { return _mm512_cmp_pd_mask(x, y, _CMP_LE_OQ); }
+    static vec blend(vec x, vec y, mask m) { return _mm512_mask_blend_pd(m, x, y); }
+    static int bits(mask m) { return (int)m; }
+    static vec lane_index(size_t i) { return _mm512_add_pd(_mm512_set1_pd((double)i), _mm512_set_pd(7, 6, 5, 4, 3, 2, 1, 0)); }
+    static vec sqrt_clamped(vec x) { return _mm512_maskz_sqrt_pd(ge(x, _mm512_setzero_pd()), x); }
+    static mask both(mask x, mask y) { return x & y; }
+    static mask either(mask x, mask y) { return x | y; }
+#elif RAGINE_KERNEL_LEVEL >= 2
+    using vec = __m256d;
+    using mask = __m256d;
+    static vec set1(double x) { return _mm256_set1_pd(x); }
+    static vec load(const double* p) { return _mm256_loadu_pd(p); }
+    static mask ge(vec x, vec y) { return _mm256_cmp_pd(x, y, _CMP_GE_OQ); }
+    static mask le(vec x, vec y) { return _mm256_cmp_pd(x, y, _CMP_LE_OQ); }
+    static vec blend(vec x, vec y, mask m) { return _mm256_blendv_pd(x, y, m); }
+    static int bits(mask m) { return _mm256_movemask_pd(m); }
+    static vec lane_index(size_t i) { return _mm256_add_pd(_mm256_set1_pd((double)i), _mm256_set_pd(3, 2, 1, 0)); }
+    static vec sqrt_clamped(vec x) { return _mm256_sqrt_pd(_mm256_max_pd(x, _mm256_setzero_pd())); }
+    static mask both(mask x, mask y) { return _mm256_and_pd(x, y); }
+    static mask either(mask x, mask y) { return _mm256_or_pd(x, y); }
+#else
+    using vec = __m128d;
+    using mask = __m128d;
+    static vec set1(double x) { return _mm_set1_pd(x); }
+    static vec load(const double* p) { return _mm_loadu_pd(p); }
+    static mask ge(vec x, vec y) { return _mm_cmpge_pd(x, y); }
+    static mask le(vec x, vec y) { return _mm_cmple_pd(x, y); }
+#if RAGINE_KERNEL_LEVEL >= 1
+    static vec blend(vec x, vec y, mask m) { return _mm_blendv_pd(x, y, m); }
+#else
+    static vec blend(vec x, vec y, mask m) { return _mm_or_pd(_mm_and_pd(m, y), _mm_andnot_pd(m, x)); }
+#endif
+    static int bits(mask m) { return _mm_movemask_pd(m); }
+    static vec lane_index(size_t i) { return _mm_add_pd(_mm_set1_pd((double)i), _mm_set_pd(1, 0)); }
+    static vec sqrt_clamped(vec x) { return _mm_sqrt_pd(_mm_max_pd(x, _mm_setzero_pd())); }
+    static mask both(mask x, mask y) { return _mm_and_pd(x, y); }
+    static mask either(mask x, mask y) { return _mm_or_pd(x, y); }
+#endif
+    static constexpr size_t lanes = sizeof(vec) / sizeof(double);
+};
+
+static constexpr size_t double_lanes = double_simd::lanes;
+#else
+static constexpr size_t double_lanes = 1;
+#endif
+
+static size_t sphere_nearest(const double* center_x, const double* center_y, const double* center_z,
+    const double* radius, size_t count, const double origin[3], const double dir[3],
+    double near_min, double far_min, double& closest, bool any_hit) {
+    double a = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+    size_t vector_end = 0;
+    size_t best = SIZE_MAX;
+
+#if defined(RAGINE_KERNEL_X86)
+    using vec = double_simd::vec;
+    using mask = double_simd::mask;
+    using ops = double_simd;
+    // 每条通道各自保留最近的交点，全部处理完后再合并，循环内没有跨通道的依赖
+    vec ox = ops::set1(origin[0]), oy = ops::set1(origin[1]), oz = ops::set1(origin[2]);
+    vec dx = ops::set1(dir[0]), dy = ops::set1(dir[1]), dz = ops::set1(dir[2]);
+    vec four_a = ops::set1(4 * a), two_a = ops::set1(2.0 * a), two = ops::set1(2.0), zero = ops::set1(0.0);
+    vec near_lo = ops::set1(near_min), far_lo = ops::set1(far_min);
+    vec best_t = ops::set1(closest), best_index = ops::set1(-1.0);
+
+    vector_end = count - count % double_lanes;
+    for (size_t i = 0; i < vector_end; i += double_lanes) {
+        vec cx = ox - ops::load(&center_x[i]), cy = oy - ops::load(&center_y[i]), cz = oz - ops::load(&center_z[i]);
+        vec rad = ops::load(&radius[i]);
+        vec b = two * (cx * dx + cy * dy + cz * dz);
+        vec c = cx * cx + cy * cy + cz * cz - rad * rad;
+        vec discriminant = b * b - four_a * c;
+        vec sqrtd = ops::sqrt_clamped(discriminant);
+        vec near_root = (zero - b - sqrtd) / two_a;
+        vec far_root = (zero - b + sqrtd) / two_a;
+
+        mask real = ops::ge(discriminant, zero);
+        mask near_ok = ops::both(ops::ge(near_root, near_lo), ops::le(near_root, best_t));
+        mask far_ok = ops::both(ops::ge(far_root, far_lo), ops::le(far_root, best_t));
+        mask ok = ops::both(real, ops::either(near_ok, far_ok));
+        if (ops::bits(ok) == 0) continue;
+
+        vec root = ops::blend(far_root, near_root, near_ok);
+        best_t = ops::blend(best_t, root, ok);
+        best_index = ops::blend(best_index, ops::lane_index(i), ok);
+        if (any_hit) break;
+    }
+
+    alignas(64) double lane_t[double_lanes], lane_index_values[double_lanes];
+    std::memcpy(lane_t, &best_t, sizeof(lane_t));
+    std::memcpy(lane_index_values, &best_index, sizeof(lane_index_values));
+    for (size_t lane = 0; lane < double_lanes; lane++) {
+        if (lane_index_values[lane] < 0.0) continue;
+        size_t index = (size_t)lane_index_values[lane];
+        if (best == SIZE_MAX || lane_t[lane] < closest || (lane_t[lane] == closest && index < best)) {
+            closest = lane_t[lane];
+            best = index;
+        }
+    }
+    if (any_hit && best != SIZE_MAX) return best;
+#endif
+
+    // 剩余不足一组的球逐个计算：先取近根，不在区间内再取远根
+    for (size_t i = vector_end; i < count; i++) {
+        double cx = origin[0] - center_x[i], cy = origin[1] - center_y[i], cz = origin[2] - center_z[i];
+        double b = 2.0 * (cx * dir[0] + cy * dir[1] + cz * dir[2]);
+        double c = cx * cx + cy * cy + cz * cz - radius[i] * radius[i];
+        double discriminant = b * b - 4 * a * c;
+        if (discriminant < 0) continue;
+
+        double sqrtd = std::sqrt(discriminant);
+        double root = (-b - sqrtd) / (2.0 * a);
+        if (root < near_min || root > closest) {
+            root = (-b + sqrtd) / (2.0 * a);
+            if (root < far_min || root > closest) continue;
+        }
+        closest = root;
+        best = i;
+        if (any_hit) break;
+    }
+    return best;
+}
+
+static void triangle_test(const double* const vertex[3][3], uint32_t count, const double origin[3],
+    const double shear[3], double near_min, double far_max, double* lane_t) {
+    const double *ax = vertex[0][0], *ay = vertex[0][1], *az = vertex[0][2];
+    const double *bx = vertex[1][0], *by = vertex[1][1], *bz = vertex[1][2];
+    const double *cx = vertex[2][0], *cy = vertex[2][1], *cz = vertex[2][2];
+    const double ox = origin[0], oy = origin[1], oz = origin[2];
+    const double sx = shear[0], sy = shear[1], sz = shear[2];
+
+    // 循环体没有分支，每个级别按各自的向量宽度展开
+    #pragma omp simd
+    for (uint32_t i = 0; i < count; i++) {
+        double a_z = az[i] - oz, b_z = bz[i] - oz, c_z = cz[i] - oz;
+        double a_x = ax[i] - ox - sx * a_z, a_y = ay[i] - oy - sy * a_z;
+        double b_x = bx[i] - ox - sx * b_z, b_y = by[i] - oy - sy * b_z;
+        double c_x = cx[i] - ox - sx * c_z, c_y = cy[i] - oy - sy * c_z;
+        double e0 = c_x * b_y - c_y * b_x;
+        double e1 = a_x * c_y - a_y * c_x;
+        double e2 = b_x * a_y - b_y * a_x;
+        double det = e0 + e1 + e2;
+        double t = (e0 * a_z + e1 * b_z + e2 * c_z) * sz / det;
+        bool inside = !(((e0 < 0) | (e1 < 0) | (e2 < 0)) & ((e0 > 0) | (e1 > 0) | (e2 > 0)));
+        lane_t[i] = (inside & (det != 0) & (t >= near_min) & (t <= far_max)) ? t : -1.0;
+    }
+}
+
+static inline uint8_t to_rgb8(double x) {
+    // 与 (unsigned char)(255.99 * std::min(0.999, std::max(0.0, x))) 相同，NaN 转换为 0
+    x = 0.0 < x ? x : 0.0;
+    x = x < 0.999 ? x : 0.999;
+    return (uint8_t)(int)(255.99 * x);
+}
+
+static void float_to_rgb8(const double* pixels, size_t stride, size_t count, uint8_t* out) {
+    // 分量紧密排列 (标量 vec3) 时整张图就是一个连续数组，按一维循环向量化
+    if (stride == 3) {
+        #pragma omp simd
+        for (size_t i = 0; i < 3 * count; i++) out[i] = to_rgb8(pixels[i]);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        for (int k = 0; k < 3; k++) out[3 * i + k] = to_rgb8(pixels[i * stride + k]);
+    }
+}
+
+static const cpu_kernels table = {
+    (cpu_isa)RAGINE_KERNEL_LEVEL,
+    double_lanes,
+    slab_test8,
+    quantized_slab_test8,
+    sphere_nearest,
+    triangle_test,
+    float_to_rgb8,
+};
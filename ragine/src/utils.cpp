@@ -17,6 +17,27 @@ vec3 sampled_gamma(const vec3& origin, int sample_times) {
     return {r, g, b};
 }
 
+bool write_ppm(const std::string& file_path, const std::vector<vec3>& image, int width, int height) {
+    if (image.size() < (size_t)width * height) {
+        std::cerr << "ERROR: Image has " << image.size() << " pixels, expected " << width << "x" << height << ".\n";
+        return false;
+    }
+
+    // 先整张转换再一次写出，不必每个分量调用一次 operator<<
+    std::vector<uint8_t> bytes((size_t)width * height * 3);
+    active_kernels().float_to_rgb8(reinterpret_cast<const double*>(image.data()), sizeof(vec3) / sizeof(double),
+        (size_t)width * height, bytes.data());
+
+    std::ofstream ofs(file_path, std::ios::binary);
+    if (!ofs) {
+        std::cerr << "ERROR: Could not open " << file_path << " for writing.\n";
+        return false;
+    }
+    ofs << "P6\n" << width << " " << height << "\n255\n";
+    ofs.write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize)bytes.size());
+    return (bool)ofs;
+}
+
 /// @brief 计算纯反射光线
 /// @param v 入射光线方向
 /// @param n 反射点法线方向